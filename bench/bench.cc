@@ -0,0 +1,253 @@
+/* bench: run the reader in several modes over the same log and report
+ * throughput, CPU time, read syscalls and peak RSS of each. Every mode is
+ * run a few times and the fastest run is kept; the first run of all warms
+ * the page cache unless --cold drops the log from it before each run */
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BENCH_READER    "bin/rlr"
+#define BENCH_RUNS      3
+#define BENCH_MAX_MODES 32
+#define BENCH_MAX_ARGS  64
+#define BENCH_TAIL      4096    /* end of the output kept for the counts */
+
+static const char* default_modes[] = {
+    "-q", "-q -m", "-q -b 64K", "-q -b 16M", "-q -a 4", "-q -j 4",
+    "-q -M", "-S", "-o json", "-o binary"
+};
+
+typedef struct run_t {
+    double wall;            /* seconds */
+    double user;
+    double sys;
+    long max_rss;           /* KB */
+    uint64_t out_bytes;
+    int64_t records;        /* -1: not printed */
+    int64_t syscalls;
+    int status;
+} run_t;
+
+static void show_usages(void);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double tv_seconds(const struct timeval* tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+/* drop the clean pages of the log from the page cache */
+static void drop_cache(char* const* logs, int n_logs) {
+    int i, fd;
+    for (i=0; i<n_logs; ++i) {
+        fd = open(logs[i], O_RDONLY);
+        if (fd == -1) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/* the last "records: N, blocks read: N, read syscalls: N" line */
+static void parse_counts(const char* tail, run_t* run) {
+    const char* line = NULL;
+    const char* p = tail;
+    unsigned long long records, blocks, syscalls;
+
+    while ((p = strstr(p, "records: "))) line = p++;
+    run->records = run->syscalls = -1;
+    if (line && sscanf(line, "records: %llu, blocks read: %llu, read syscalls: %llu",
+                &records, &blocks, &syscalls) == 3) {
+        run->records = records;
+        run->syscalls = syscalls;
+    }
+}
+
+/* run the reader once with the options of mode over the logs; its output
+ * is counted and dropped */
+static int run_reader(const char* reader, const char* mode, char* const* logs,
+        int n_logs, run_t* run) {
+    char* args[BENCH_MAX_ARGS];
+    char* mode_copy = strdup(mode);
+    char buf[65536], tail[BENCH_TAIL + 1];
+    size_t tail_len = 0;
+    struct rusage usage;
+    int n = 0, i, pipe_fd[2];
+    char* token;
+    ssize_t ret;
+    double start;
+    pid_t pid;
+
+    if (!mode_copy) {
+        perror("strdup");
+        exit(2);
+    }
+    args[n++] = (char*)reader;
+    for (token=strtok(mode_copy, " "); token && n<BENCH_MAX_ARGS - n_logs - 1;
+            token=strtok(NULL, " "))
+        args[n++] = token;
+    for (i=0; i<n_logs; ++i) args[n++] = logs[i];
+    args[n] = NULL;
+
+    if (pipe(pipe_fd) == -1) {
+        perror("pipe");
+        free(mode_copy);
+        return 0;
+    }
+    start = now();
+    pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        free(mode_copy);
+        return 0;
+    }
+    if (pid == 0) {
+        dup2(pipe_fd[1], STDOUT_FILENO);
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
+        execv(reader, args);
+        perror(reader);
+        _exit(127);
+    }
+    close(pipe_fd[1]);
+    free(mode_copy);
+
+    run->out_bytes = 0;
+    while ((ret = read(pipe_fd[0], buf, sizeof(buf))) > 0) {
+        run->out_bytes += ret;
+        /* keep the last BENCH_TAIL bytes */
+        if (ret >= BENCH_TAIL) {
+            memcpy(tail, buf + ret - BENCH_TAIL, BENCH_TAIL);
+            tail_len = BENCH_TAIL;
+        } else {
+            if (tail_len + ret > BENCH_TAIL) {
+                memmove(tail, tail + tail_len + ret - BENCH_TAIL,
+                        BENCH_TAIL - ret);
+                tail_len = BENCH_TAIL - ret;
+            }
+            memcpy(tail + tail_len, buf, ret);
+            tail_len += ret;
+        }
+    }
+    close(pipe_fd[0]);
+    if (wait4(pid, &run->status, 0, &usage) == -1) {
+        perror("wait4");
+        return 0;
+    }
+    run->wall = now() - start;
+    run->user = tv_seconds(&usage.ru_utime);
+    run->sys = tv_seconds(&usage.ru_stime);
+    run->max_rss = usage.ru_maxrss;
+    tail[tail_len] = '\0';
+    parse_counts(tail, run);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        { "runs", required_argument, NULL, 'r' },
+        { "reader", required_argument, NULL, 'x' },
+        { "mode", required_argument, NULL, 'm' },
+        { "cold", no_argument, NULL, 'c' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char* modes[BENCH_MAX_MODES];
+    const char* reader = BENCH_READER;
+    int opt_char, n_modes = 0, runs = BENCH_RUNS, cold = 0, i, j, n_logs;
+    int64_t records = -1;
+    char* const* logs;
+    off_t log_bytes = 0;
+    struct stat st;
+    run_t run, best;
+    char syscalls[32];
+
+    while ((opt_char = getopt_long(argc, argv, "r:x:m:c", long_options, NULL)) != -1) {
+        switch (opt_char) {
+            case 'r': runs = atoi(optarg); break;
+            case 'x': reader = optarg; break;
+            case 'c': cold = 1; break;
+            case 'm':
+                if (n_modes == BENCH_MAX_MODES) {
+                    printf("at most %d modes\n", BENCH_MAX_MODES);
+                    return 1;
+                }
+                modes[n_modes++] = optarg;
+                break;
+            default:
+                show_usages();
+                return 1;
+        }
+    }
+    if (optind == argc || runs < 1) {
+        show_usages();
+        return 1;
+    }
+    logs = argv + optind;
+    n_logs = argc - optind;
+    for (i=0; i<n_logs; ++i) {
+        if (stat(logs[i], &st) == -1) {
+            perror(logs[i]);
+            return 2;
+        }
+        log_bytes += st.st_size;
+    }
+    if (n_modes == 0) {
+        n_modes = sizeof(default_modes) / sizeof(*default_modes);
+        for (i=0; i<n_modes; ++i) modes[i] = default_modes[i];
+    }
+
+    /* warm up, and count the records for the modes that do not print it */
+    if (!run_reader(reader, "-q", logs, n_logs, &run)) return 2;
+    records = run.records;
+
+    printf("log: %.1f MB, %"PRId64" records, best of %d run%s%s\n",
+            log_bytes / 1048576.0, records, runs, runs > 1 ? "s" : "",
+            cold ? ", page cache dropped before each" : "");
+    printf("%-20s %9s %11s %8s %8s %8s %9s %10s %10s\n", "mode", "MB/s",
+            "records/s", "wall s", "user s", "sys s", "syscalls", "peak RSS K",
+            "output MB");
+    for (i=0; i<n_modes; ++i) {
+        for (j=0; j<runs; ++j) {
+            if (cold) drop_cache(logs, n_logs);
+            if (!run_reader(reader, modes[i], logs, n_logs, &run)) return 2;
+            if (j == 0 || run.wall < best.wall) best = run;
+        }
+        if (!WIFEXITED(best.status) || WEXITSTATUS(best.status)) {
+            printf("%-20s failed with status %d\n", modes[i], best.status);
+            continue;
+        }
+        if (best.records < 0) best.records = records;
+        if (best.syscalls >= 0)
+            snprintf(syscalls, sizeof(syscalls), "%"PRId64, best.syscalls);
+        else
+            strcpy(syscalls, "-");
+        printf("%-20s %9.1f %11.0f %8.3f %8.3f %8.3f %9s %10ld %10.1f\n",
+                modes[i], log_bytes / 1048576.0 / best.wall,
+                best.records / best.wall, best.wall, best.user, best.sys,
+                syscalls, best.max_rss, best.out_bytes / 1048576.0);
+    }
+    return 0;
+}
+
+static void show_usages(void) {
+    printf("Usages: bench [options] ib_logfile0 [ib_logfile1 ...]\n"
+           "  -m, --mode \"OPTIONS\"     reader options of a mode, e.g. \"-q -m\"; may\n"
+           "                           be given several times (default: a set of modes)\n"
+           "  -r, --runs N             runs of each mode, the fastest is kept (default %d)\n"
+           "  -x, --reader PATH        the reader to run (default %s)\n"
+           "  -c, --cold               drop the log from the page cache before each run\n",
+           BENCH_RUNS, BENCH_READER);
+}
@@ -0,0 +1,652 @@
+/* gen_log: write a synthetic MySQL 5.6/5.7 redo log group for benchmarks.
+ * The files have a valid header and checkpoint, every block its number,
+ * data length, first_rec_group and checksum, and the records are random
+ * mini-transactions of a given record type mix. The same options and seed
+ * always give the same files */
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <getopt.h>
+
+#include "../redo_log_reader.h"
+
+#define GEN_FILE_SIZE   (48 << 20)  /* innodb_log_file_size of 5.6 */
+#define GEN_START_LSN   8192        /* LOG_START_LSN */
+#define GEN_MAX_BODY    64          /* longest string in a body */
+#define GEN_SPACES      50
+#define GEN_PAGES       5000
+#define GEN_MTR_RECS    6           /* most records in an mtr */
+#define GEN_WRITE_SIZE  (1 << 20)
+#define GEN_NO_CHECKSUM (-1)        /* LOG_NO_CHECKSUM_MAGIC in every block */
+
+/* the default mix: roughly the share of each type in an OLTP workload */
+static const struct {
+    byte type;
+    uint32_t weight;
+} default_mix[] = {
+    { MLOG_1BYTE, 4 }, { MLOG_2BYTES, 10 }, { MLOG_4BYTES, 8 },
+    { MLOG_8BYTES, 3 }, { MLOG_WRITE_STRING, 6 }, { MLOG_UNDO_INSERT, 8 },
+    { MLOG_COMP_REC_INSERT, 10 }, { MLOG_REC_INSERT, 1 },
+    { MLOG_COMP_REC_UPDATE_IN_PLACE, 8 }, { MLOG_REC_UPDATE_IN_PLACE, 1 },
+    { MLOG_COMP_REC_CLUST_DELETE_MARK, 2 }, { MLOG_COMP_REC_SEC_DELETE_MARK, 2 },
+    { MLOG_COMP_REC_DELETE, 2 }, { MLOG_REC_DELETE, 1 },
+    { MLOG_UNDO_INIT, 1 }, { MLOG_UNDO_HDR_CREATE, 1 }, { MLOG_UNDO_HDR_REUSE, 1 },
+    { MLOG_COMP_PAGE_CREATE, 1 }, { MLOG_PAGE_CREATE, 1 }, { MLOG_INIT_FILE_PAGE, 1 },
+    { MLOG_COMP_REC_MIN_MARK, 1 }, { MLOG_COMP_PAGE_REORGANIZE, 1 },
+    { MLOG_FILE_NAME, 1 }
+};
+
+typedef struct gen_t {
+    uint64_t rnd;               /* xorshift64 state */
+    uint32_t weights[MLOG_BIGGEST_TYPE + 1];
+    uint32_t total_weight;
+    size_t max_body;
+    uint32_t n_spaces;
+    uint32_t n_pages;
+    int mtr_recs;
+    int checksum;               /* CHECKSUM_CRC32, CHECKSUM_INNODB or GEN_NO_CHECKSUM */
+    int checkpoint_57;          /* a 5.7 checkpoint block instead of a 5.6 field */
+    size_t partial;             /* bytes of an mtr the log starts with */
+    uint64_t checkpoint_lsn;    /* of the first whole mtr */
+
+    char* const* paths;
+    int n_files;
+    int file;
+    int fd;
+    off_t file_size;
+    off_t file_offset;          /* of the next block in the current file */
+    byte* out;                  /* blocks not written yet */
+    size_t out_len;
+
+    byte block[OS_FILE_LOG_BLOCK_SIZE];
+    size_t block_len;           /* LOG_BLOCK_HDR_DATA_LEN so far */
+    uint64_t lsn;               /* of the start of the current block */
+    uint64_t blocks_left;       /* in the whole group, the current one included */
+
+    byte* mtr;                  /* the records of the mtr being built */
+    size_t mtr_len;
+    size_t mtr_size;
+
+    uint64_t mtrs;
+    uint64_t records;
+} gen_t;
+
+static void show_usages(void);
+
+static uint64_t gen_rand(gen_t* gen) {
+    gen->rnd ^= gen->rnd << 13;
+    gen->rnd ^= gen->rnd >> 7;
+    gen->rnd ^= gen->rnd << 17;
+    return gen->rnd;
+}
+
+static void write_be(byte* dst, uint64_t val, int n) {
+    while (n--) {
+        dst[n] = (byte)val;
+        val >>= 8;
+    }
+}
+
+static byte* mtr_reserve(gen_t* gen, size_t n) {
+    byte* ptr;
+    if (gen->mtr_len + n > gen->mtr_size) {
+        while (gen->mtr_len + n > gen->mtr_size) gen->mtr_size *= 2;
+        gen->mtr = realloc(gen->mtr, gen->mtr_size);
+        if (!gen->mtr) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    ptr = gen->mtr + gen->mtr_len;
+    gen->mtr_len += n;
+    return ptr;
+}
+
+static void put_n(gen_t* gen, uint64_t val, int n) {
+    write_be(mtr_reserve(gen, n), val, n);
+}
+
+/* mach_write_compressed */
+static void put_compressed(gen_t* gen, uint32_t val) {
+    if (val < 0x80) put_n(gen, val, 1);
+    else if (val < 0x4000) put_n(gen, val | 0x8000, 2);
+    else if (val < 0x200000) put_n(gen, val | 0xC00000, 3);
+    else if (val < 0x10000000) put_n(gen, val | 0xE0000000, 4);
+    else {
+        put_n(gen, 0xF0, 1);
+        put_n(gen, val, 4);
+    }
+}
+
+/* mach_u64_write_much_compressed as read by mach_u64_parse_compressed */
+static void put_compressed_64(gen_t* gen, uint64_t val) {
+    put_compressed(gen, val >> 32);
+    put_n(gen, (uint32_t)val, 4);
+}
+
+static void put_string(gen_t* gen, size_t len) {
+    byte* ptr = mtr_reserve(gen, len);
+    while (len--) *ptr++ = 'a' + gen_rand(gen) % 26;
+}
+
+static size_t body_len(gen_t* gen) {
+    return 1 + gen_rand(gen) % gen->max_body;
+}
+
+static void put_page_offset(gen_t* gen) {
+    put_n(gen, FIL_PAGE_DATA + gen_rand(gen) % (UNIV_PAGE_SIZE - 2 * FIL_PAGE_DATA), 2);
+}
+
+/* the index of the compact record types, see parse_index */
+static void put_index(gen_t* gen, int comp) {
+    uint16_t i, n_fields = 2 + gen_rand(gen) % 4;
+    if (!comp) return;
+    put_n(gen, n_fields, 2);
+    put_n(gen, 1, 2);
+    for (i=0; i<n_fields; ++i) put_n(gen, i ? 0x7FFF : 0x8004, 2);
+}
+
+/* row_upd_write_sys_vals_to_log */
+static void put_trx_id(gen_t* gen) {
+    put_compressed(gen, 1 + gen_rand(gen) % 3);
+    put_n(gen, gen_rand(gen) & 0xFFFFFFFFFFFFFFULL, DATA_ROLL_PTR_LEN);
+    put_compressed_64(gen, gen_rand(gen) % 100000000);
+}
+
+/* the body of a record of type, as reader_next_record parses it */
+static void put_body(gen_t* gen, byte type) {
+    size_t len;
+    uint32_t i, n;
+    int comp = 0;
+
+    switch (type) {
+        case MLOG_1BYTE:
+        case MLOG_2BYTES:
+        case MLOG_4BYTES:
+            put_page_offset(gen);
+            put_compressed(gen, gen_rand(gen) >> (64 - 8 * type));
+            break;
+        case MLOG_8BYTES:
+            put_page_offset(gen);
+            put_compressed_64(gen, gen_rand(gen));
+            break;
+        case MLOG_COMP_REC_INSERT:
+            comp = 1;
+            /* fall through */
+        case MLOG_REC_INSERT:
+            put_index(gen, comp);
+            put_page_offset(gen);
+            len = body_len(gen);
+            if (gen_rand(gen) % 2) {
+                put_compressed(gen, len << 1 | 1);
+                put_n(gen, 0, 1);
+                put_compressed(gen, gen_rand(gen) % 300);
+                put_compressed(gen, gen_rand(gen) % 10);
+            } else {
+                put_compressed(gen, len << 1);
+            }
+            put_string(gen, len);
+            break;
+        case MLOG_COMP_REC_UPDATE_IN_PLACE:
+            comp = 1;
+            /* fall through */
+        case MLOG_REC_UPDATE_IN_PLACE:
+            put_index(gen, comp);
+            put_n(gen, 0, 1);
+            put_trx_id(gen);
+            put_page_offset(gen);
+            put_n(gen, 0, 1);
+            n = 1 + gen_rand(gen) % 3;
+            put_compressed(gen, n);
+            for (i=0; i<n; ++i) {
+                len = gen_rand(gen) % (gen->max_body + 1);
+                put_compressed(gen, i + 1);
+                put_compressed(gen, len);
+                put_string(gen, len);
+            }
+            break;
+        case MLOG_COMP_REC_CLUST_DELETE_MARK:
+            comp = 1;
+            /* fall through */
+        case MLOG_REC_CLUST_DELETE_MARK:
+            put_index(gen, comp);
+            put_n(gen, 0, 1);
+            put_n(gen, 1, 1);
+            put_trx_id(gen);
+            put_page_offset(gen);
+            break;
+        case MLOG_COMP_REC_SEC_DELETE_MARK:
+            put_index(gen, 1);
+            /* fall through */
+        case MLOG_REC_SEC_DELETE_MARK:
+            put_n(gen, 1, 1);
+            put_page_offset(gen);
+            break;
+        case MLOG_COMP_REC_DELETE:
+        case MLOG_COMP_LIST_END_DELETE:
+        case MLOG_COMP_LIST_START_DELETE:
+            comp = 1;
+            /* fall through */
+        case MLOG_REC_DELETE:
+        case MLOG_LIST_END_DELETE:
+        case MLOG_LIST_START_DELETE:
+            put_index(gen, comp);
+            put_page_offset(gen);
+            break;
+        case MLOG_COMP_PAGE_REORGANIZE:
+        case MLOG_PAGE_REORGANIZE:
+            put_index(gen, type == MLOG_COMP_PAGE_REORGANIZE);
+            break;
+        case MLOG_REC_MIN_MARK:
+        case MLOG_COMP_REC_MIN_MARK:
+            put_page_offset(gen);
+            break;
+        case MLOG_WRITE_STRING:
+            len = body_len(gen);
+            put_page_offset(gen);
+            put_n(gen, len, 2);
+            put_string(gen, len);
+            break;
+        case MLOG_UNDO_INSERT:
+            len = body_len(gen);
+            put_n(gen, len, 2);
+            put_string(gen, len);
+            break;
+        case MLOG_UNDO_INIT:
+            put_compressed(gen, 1 + gen_rand(gen) % 2);
+            break;
+        case MLOG_UNDO_HDR_CREATE:
+        case MLOG_UNDO_HDR_REUSE:
+            put_compressed_64(gen, gen_rand(gen) % 100000000);
+            break;
+        case MLOG_FILE_NAME:
+            len = 8 + gen_rand(gen) % 24;
+            put_n(gen, len + 1, 2);
+            put_string(gen, len);
+            put_n(gen, 0, 1);
+            break;
+        case MLOG_ZIP_PAGE_COMPRESS:
+            len = body_len(gen);
+            put_n(gen, len, 2);
+            put_n(gen, 0, 2);
+            put_string(gen, 8 + len);
+            break;
+        default:
+            /* no body: page creation and the like */
+            break;
+    }
+}
+
+static byte pick_type(gen_t* gen) {
+    uint32_t r = gen_rand(gen) % gen->total_weight;
+    byte type;
+    for (type=0; r >= gen->weights[type]; ++type) r -= gen->weights[type];
+    return type;
+}
+
+/* one mtr: a single record with MLOG_SINGLE_REC_FLAG, or a few records
+ * and MLOG_MULTI_REC_END. Returns the number of records */
+static int build_mtr(gen_t* gen) {
+    int i, n = gen_rand(gen) % 4 == 0 ? 1 : 2 + gen_rand(gen) % (gen->mtr_recs - 1);
+    uint32_t space_id;
+    byte type;
+
+    if (gen->mtr_recs == 1) n = 1;
+    gen->mtr_len = 0;
+    for (i=0; i<n; ++i) {
+        type = pick_type(gen);
+        space_id = gen_rand(gen) % gen->n_spaces;
+        put_n(gen, n == 1 ? type | MLOG_SINGLE_REC_FLAG : type, 1);
+        put_compressed(gen, space_id);
+        put_compressed(gen, type == MLOG_FILE_NAME ? 0 : gen_rand(gen) % gen->n_pages);
+        put_body(gen, type);
+    }
+    if (n == 1) return 1;
+    put_n(gen, MLOG_MULTI_REC_END, 1);
+    return n + 1;
+}
+
+static int flush_out(gen_t* gen) {
+    size_t done = 0;
+    ssize_t ret;
+    while (done < gen->out_len) {
+        ret = write(gen->fd, gen->out + done, gen->out_len - done);
+        if (ret <= 0) {
+            perror("write");
+            return 0;
+        }
+        done += ret;
+    }
+    gen->out_len = 0;
+    return 1;
+}
+
+/* the file header with the start LSN of the file; the first file also
+ * gets a checkpoint at the start of the log */
+static int open_file(gen_t* gen) {
+    byte hdr[LOG_FILE_HDR_SIZE];
+    byte* cp = hdr + LOG_CHECKPOINT_1;
+    off_t data_size = gen->file_size - LOG_FILE_HDR_SIZE;
+    const char* path = gen->paths[gen->file];
+
+    gen->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (gen->fd == -1) {
+        perror(path);
+        return 0;
+    }
+    memset(hdr, 0, sizeof(hdr));
+    write_be(hdr + LOG_FILE_START_LSN, GEN_START_LSN + gen->file * data_size, 8);
+    if (gen->file == 0 && gen->checkpoint_57) {
+        write_be(cp + LOG_CHECKPOINT_NO, 1, 8);
+        write_be(cp + LOG_CHECKPOINT_LSN, gen->checkpoint_lsn, 8);
+        write_be(cp + LOG_CHECKPOINT_OFFSET,
+                LOG_FILE_HDR_SIZE + gen->checkpoint_lsn - GEN_START_LSN, 8);
+        write_be(cp + LOG_CHECKPOINT_BUF_SIZE_57, 8 << 20, 4);
+        write_be(cp + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_CHECKSUM,
+                crc32c(cp, OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE), 4);
+    } else if (gen->file == 0) {
+        write_be(cp + LOG_CHECKPOINT_NO, 1, 8);
+        write_be(cp + LOG_CHECKPOINT_LSN, gen->checkpoint_lsn, 8);
+        write_be(cp + LOG_CHECKPOINT_OFFSET_LOW32,
+                LOG_FILE_HDR_SIZE + gen->checkpoint_lsn - GEN_START_LSN, 4);
+        write_be(cp + LOG_CHECKPOINT_LOG_BUF_SIZE, 8 << 20, 4);
+        write_be(cp + LOG_CHECKPOINT_ARCHIVED_LSN, UINT64_MAX, 8);
+        write_be(cp + LOG_CHECKPOINT_CHECKSUM_1,
+                (uint32_t)fold_binary(cp, LOG_CHECKPOINT_CHECKSUM_1), 4);
+        write_be(cp + LOG_CHECKPOINT_CHECKSUM_2,
+                (uint32_t)fold_binary(cp + LOG_CHECKPOINT_LSN,
+                    LOG_CHECKPOINT_CHECKSUM_2 - LOG_CHECKPOINT_LSN), 4);
+    }
+    memcpy(gen->out, hdr, sizeof(hdr));
+    gen->out_len = sizeof(hdr);
+    gen->file_offset = LOG_FILE_HDR_SIZE;
+    return 1;
+}
+
+/* the rest of the file reads as zeros, blocks past the end of the log */
+static int close_file(gen_t* gen) {
+    int ok = flush_out(gen) && ftruncate(gen->fd, gen->file_size) == 0;
+    if (!ok) perror("ftruncate");
+    close(gen->fd);
+    return ok;
+}
+
+static void start_block(gen_t* gen) {
+    memset(gen->block, 0, sizeof(gen->block));
+    write_be(gen->block + LOG_BLOCK_HDR_NO,
+            ((gen->lsn / OS_FILE_LOG_BLOCK_SIZE) & 0x3FFFFFFFUL) + 1, 4);
+    write_be(gen->block + LOG_BLOCK_CHECKPOINT_NO, 1, 4);
+    gen->block_len = LOG_BLOCK_HDR_SIZE;
+}
+
+/* fill in the length and checksum of the current block and queue it */
+static int finish_block(gen_t* gen) {
+    byte* block = gen->block;
+    uint32_t checksum;
+
+    write_be(block + LOG_BLOCK_HDR_DATA_LEN, gen->block_len, 2);
+    if (gen->checksum == CHECKSUM_CRC32)
+        checksum = crc32c(block, OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE);
+    else if (gen->checksum == CHECKSUM_INNODB)
+        checksum = log_block_checksum_innodb(block);
+    else
+        checksum = LOG_NO_CHECKSUM_MAGIC;
+    write_be(block + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_CHECKSUM, checksum, 4);
+
+    if (gen->out_len + OS_FILE_LOG_BLOCK_SIZE > GEN_WRITE_SIZE && !flush_out(gen))
+        return 0;
+    memcpy(gen->out + gen->out_len, block, OS_FILE_LOG_BLOCK_SIZE);
+    gen->out_len += OS_FILE_LOG_BLOCK_SIZE;
+    gen->file_offset += OS_FILE_LOG_BLOCK_SIZE;
+    return 1;
+}
+
+/* log_write_low: copy the mtr into the blocks, the next block starting
+ * when one is full. The tail of an mtr does not start a record group */
+static int write_mtr(gen_t* gen, int tail) {
+    size_t done = 0, n;
+    int first = !tail;
+
+    while (done < gen->mtr_len) {
+        if (gen->block_len == OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE) {
+            gen->block_len = OS_FILE_LOG_BLOCK_SIZE;
+            if (!finish_block(gen)) return 0;
+            gen->lsn += OS_FILE_LOG_BLOCK_SIZE;
+            --gen->blocks_left;
+            if (gen->file_offset == gen->file_size) {
+                if (!close_file(gen)) return 0;
+                ++gen->file;
+                if (!open_file(gen)) return 0;
+            }
+            start_block(gen);
+        }
+        if (first && mach_read_2(gen->block + LOG_BLOCK_FIRST_REC_GROUP) == 0)
+            write_be(gen->block + LOG_BLOCK_FIRST_REC_GROUP, gen->block_len, 2);
+        first = 0;
+
+        n = OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE - gen->block_len;
+        if (n > gen->mtr_len - done) n = gen->mtr_len - done;
+        memcpy(gen->block + gen->block_len, gen->mtr + done, n);
+        gen->block_len += n;
+        done += n;
+    }
+    return 1;
+}
+
+/* --mix TYPE:WEIGHT,... with type numbers or names, with or without the
+ * MLOG_ prefix; only the types put_body knows */
+static int parse_mix(gen_t* gen, const char* list) {
+    char name[64];
+    const char *end, *colon, *known;
+    size_t len;
+    int type;
+
+    memset(gen->weights, 0, sizeof(gen->weights));
+    while (*list) {
+        end = strchr(list, ',');
+        if (!end) end = list + strlen(list);
+        len = end - list;
+        if (len == 0 || len >= sizeof(name)) return 0;
+        memcpy(name, list, len);
+        name[len] = '\0';
+        list = *end ? end + 1 : end;
+
+        colon = strchr(name, ':');
+        if (colon) name[colon - name] = '\0';
+        if (name[0] >= '0' && name[0] <= '9') {
+            type = atoi(name);
+        } else {
+            for (type=0; type<=MLOG_BIGGEST_TYPE; ++type) {
+                known = log_type_name(type);
+                if (strncmp(known, "MLOG_", 5)) continue;
+                if (!strcasecmp(name, known) || !strcasecmp(name, known + 5))
+                    break;
+            }
+        }
+        /* records the reader cannot parse back or that end an mtr */
+        if (type < MLOG_1BYTE || type > MLOG_BIGGEST_TYPE
+            || !strncmp(log_type_name(type), "UNKNOW", 6)
+            || type == MLOG_MULTI_REC_END || type == MLOG_DUMMY_RECORD
+            || type == MLOG_CHECKPOINT || type == MLOG_LIST_END_COPY_CREATED
+            || type == MLOG_COMP_LIST_END_COPY_CREATED
+            || (type >= MLOG_FILE_CREATE && type <= MLOG_FILE_DELETE)
+            || type == MLOG_FILE_CREATE2 || type == MLOG_FILE_RENAME2
+            || (type >= MLOG_ZIP_WRITE_NODE_PTR && type <= MLOG_ZIP_WRITE_HEADER)
+            || type == MLOG_ZIP_PAGE_COMPRESS_NO_DATA
+            || type == MLOG_ZIP_PAGE_REORGANIZE)
+            return 0;
+        gen->weights[type] = colon ? strtoul(colon + 1, NULL, 10) : 1;
+    }
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        { "size", required_argument, NULL, 's' },
+        { "seed", required_argument, NULL, 'r' },
+        { "mix", required_argument, NULL, 't' },
+        { "max-body", required_argument, NULL, 'l' },
+        { "spaces", required_argument, NULL, 'S' },
+        { "pages", required_argument, NULL, 'P' },
+        { "mtr-records", required_argument, NULL, 'M' },
+        { "checksum", required_argument, NULL, 'k' },
+        { "fill", required_argument, NULL, 'f' },
+        { "checkpoint", required_argument, NULL, 'c' },
+        { "partial", required_argument, NULL, 'p' },
+        { NULL, 0, NULL, 0 }
+    };
+    gen_t gen;
+    int opt_char, fill = 100, n;
+    uint64_t seed = 1, end_lsn;
+    size_t i;
+
+    memset(&gen, 0, sizeof(gen));
+    gen.file_size = GEN_FILE_SIZE;
+    gen.max_body = GEN_MAX_BODY;
+    gen.n_spaces = GEN_SPACES;
+    gen.n_pages = GEN_PAGES;
+    gen.mtr_recs = GEN_MTR_RECS;
+    gen.checksum = CHECKSUM_CRC32;
+    for (i=0; i<sizeof(default_mix) / sizeof(*default_mix); ++i)
+        gen.weights[default_mix[i].type] = default_mix[i].weight;
+
+    while ((opt_char = getopt_long(argc, argv, "s:r:t:l:S:P:M:k:f:c:p:",
+                    long_options, NULL)) != -1) {
+        switch (opt_char) {
+            case 's': gen.file_size = parse_size(optarg); break;
+            case 'r': seed = strtoull(optarg, NULL, 10); break;
+            case 'l': gen.max_body = strtoul(optarg, NULL, 10); break;
+            case 'S': gen.n_spaces = strtoul(optarg, NULL, 10); break;
+            case 'P': gen.n_pages = strtoul(optarg, NULL, 10); break;
+            case 'M': gen.mtr_recs = atoi(optarg); break;
+            case 'f': fill = atoi(optarg); break;
+            case 'p': gen.partial = strtoul(optarg, NULL, 10); break;
+            case 'c':
+                if (!strcmp(optarg, "5.6")) gen.checkpoint_57 = 0;
+                else if (!strcmp(optarg, "5.7")) gen.checkpoint_57 = 1;
+                else {
+                    show_usages();
+                    return 1;
+                }
+                break;
+            case 't':
+                if (!parse_mix(&gen, optarg)) {
+                    printf("bad type in %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                if (!strcmp(optarg, "crc32")) gen.checksum = CHECKSUM_CRC32;
+                else if (!strcmp(optarg, "innodb")) gen.checksum = CHECKSUM_INNODB;
+                else if (!strcmp(optarg, "none")) gen.checksum = GEN_NO_CHECKSUM;
+                else {
+                    show_usages();
+                    return 1;
+                }
+                break;
+            default:
+                show_usages();
+                return 1;
+        }
+    }
+    gen.file_size -= gen.file_size % OS_FILE_LOG_BLOCK_SIZE;
+    for (i=0; i<=MLOG_BIGGEST_TYPE; ++i) gen.total_weight += gen.weights[i];
+    if (optind == argc || gen.file_size < LOG_FILE_HDR_SIZE + 4 * OS_FILE_LOG_BLOCK_SIZE
+        || gen.max_body < 1 || gen.max_body > 0xFFFF || !gen.n_spaces || !gen.n_pages
+        || gen.mtr_recs < 1 || fill < 1 || fill > 100 || !gen.total_weight
+        || gen.partial >= (size_t)(gen.file_size - LOG_FILE_HDR_SIZE) / 2) {
+        show_usages();
+        return 1;
+    }
+
+    gen.rnd = 0x9E3779B97F4A7C15ULL ^ seed;
+    gen.paths = argv + optind;
+    gen.n_files = argc - optind;
+    gen.mtr_size = 4096;
+    gen.mtr = malloc(gen.mtr_size);
+    gen.out = malloc(GEN_WRITE_SIZE);
+    if (!gen.mtr || !gen.out) {
+        perror("malloc");
+        return 2;
+    }
+    /* keep the last block of the group empty, so a reader of the group
+     * does not wrap around to the first block */
+    gen.blocks_left = (uint64_t)(gen.file_size - LOG_FILE_HDR_SIZE)
+        / OS_FILE_LOG_BLOCK_SIZE * gen.n_files * fill / 100;
+    if (fill == 100) --gen.blocks_left;
+    gen.lsn = GEN_START_LSN;
+    /* the checkpoint is at the first mtr after the partial one, in the
+     * block the partial one ends in or the next when it ends a block */
+    gen.checkpoint_lsn = GEN_START_LSN;
+    if (gen.partial)
+        gen.checkpoint_lsn += gen.partial / LOG_BLOCK_DATA_SIZE * OS_FILE_LOG_BLOCK_SIZE
+            + LOG_BLOCK_HDR_SIZE + gen.partial % LOG_BLOCK_DATA_SIZE;
+    if (!open_file(&gen)) return 2;
+    start_block(&gen);
+
+    /* a log starting in the middle of an mtr: the last bytes of one
+     * longer than partial, as if the log before had been overwritten */
+    if (gen.partial) {
+        for (i=0; i<1000000; ++i) {
+            build_mtr(&gen);
+            if (gen.mtr_len > gen.partial) break;
+        }
+        if (gen.mtr_len <= gen.partial) {
+            printf("no mtr longer than %zu bytes, try a larger --max-body\n",
+                    gen.partial);
+            return 1;
+        }
+        memmove(gen.mtr, gen.mtr + gen.mtr_len - gen.partial, gen.partial);
+        gen.mtr_len = gen.partial;
+        if (!write_mtr(&gen, 1)) return 2;
+    }
+
+    while (1) {
+        n = build_mtr(&gen);
+        /* stop before an mtr that does not fit */
+        if (gen.mtr_len > (gen.blocks_left - 1) * LOG_BLOCK_DATA_SIZE
+                + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE - gen.block_len)
+            break;
+        if (!write_mtr(&gen, 0)) return 2;
+        ++gen.mtrs;
+        gen.records += n;
+    }
+    /* the partial block the log ends in */
+    end_lsn = gen.lsn + gen.block_len;
+    if (gen.block_len == OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE)
+        gen.block_len = OS_FILE_LOG_BLOCK_SIZE;
+    if (gen.block_len > LOG_BLOCK_HDR_SIZE && !finish_block(&gen)) return 2;
+    if (!close_file(&gen)) return 2;
+    /* the files after the end of the log */
+    for (++gen.file; gen.file<gen.n_files; ++gen.file)
+        if (!open_file(&gen) || !close_file(&gen)) return 2;
+
+    printf("files: %d of %lld bytes, lsn %d - %"PRIu64", mtrs: %"PRIu64
+            ", records: %"PRIu64"\n", gen.n_files, (long long)gen.file_size,
+            GEN_START_LSN, end_lsn, gen.mtrs, gen.records);
+    free(gen.mtr);
+    free(gen.out);
+    return 0;
+}
+
+static void show_usages(void) {
+    printf("Usages: gen_log [options] ib_logfile0 [ib_logfile1 ...]\n"
+           "  -s, --size SIZE          size of each file (default %dM)\n"
+           "  -r, --seed N             random seed (default 1)\n"
+           "  -t, --mix TYPE:W,...     record types and their weights, e.g.\n"
+           "                           WRITE_STRING:5,2BYTES:10 (default: an OLTP mix)\n"
+           "  -l, --max-body N         longest string in a record body (default %d)\n"
+           "  -S, --spaces N           space ids 0 .. N-1 (default %d)\n"
+           "  -P, --pages N            page numbers 0 .. N-1 (default %d)\n"
+           "  -M, --mtr-records N      most records in a mini-transaction (default %d)\n"
+           "  -k, --checksum ALG       crc32 (default), innodb or none\n"
+           "  -f, --fill PERCENT       share of the group the log takes (default 100)\n"
+           "  -c, --checkpoint FORMAT  5.6 (default) or 5.7 checkpoint field\n"
+           "  -p, --partial N          start the log with the last N bytes of an mtr\n",
+           GEN_FILE_SIZE >> 20, GEN_MAX_BODY, GEN_SPACES, GEN_PAGES, GEN_MTR_RECS);
+}
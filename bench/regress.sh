@@ -0,0 +1,86 @@
+#!/bin/sh
+# regress.sh: write a few logs with gen_log, parse each in every mode and
+# compare the records with those of the default mode.
+#   bench/regress.sh [BIN_DIR]    (default: bin, with rlr and gen_log)
+# Prints the modes that differ and exits with 1 if there is one.
+
+BIN=${1:-bin}
+RLR=$BIN/rlr
+GEN=$BIN/gen_log
+DIR=$(mktemp -d) || exit 2
+trap 'rm -rf "$DIR"' EXIT
+failed=0
+
+# check NAME EXPECTED ACTUAL: compare two outputs
+check() {
+    if cmp -s "$2" "$3"; then
+        echo "ok      $1"
+    else
+        echo "FAILED  $1"
+        failed=1
+    fi
+}
+
+# modes LOG CHECKPOINT: every reading mode of one file against the default
+# mode; CHECKPOINT is 1 when the file has the checkpoint (the first of the
+# group), which gen_log puts at the first record group
+modes() {
+    log=$1
+    "$RLR" -o json "$log" > "$DIR/base" || failed=1
+    "$RLR" "$log" | grep -v '^records:' > "$DIR/base.txt"
+    for mode in "-m" "-b 4K" "-m -b 4K" "-a 2" "-a 2 -b 8K" "-j 3" "-j 3 -m" \
+            "-j 4 -a 2 -b 16K"; do
+        "$RLR" -o json $mode "$log" > "$DIR/out"
+        check "$(basename "$log") $mode" "$DIR/base" "$DIR/out"
+    done
+    for mode in "-m" "-j 3"; do
+        "$RLR" $mode "$log" | grep -v '^records:' > "$DIR/out"
+        check "$(basename "$log") $mode (text)" "$DIR/base.txt" "$DIR/out"
+    done
+    # -M drops the mtr a file ends in, so only a whole log compares
+    if [ "$2" = 1 ]; then
+        for mode in "-c" "-g" "-c -m" "-g -m -b 4K" "-M" "-M -m" "-M -j 3"; do
+            "$RLR" -o json $mode "$log" > "$DIR/out"
+            check "$(basename "$log") $mode" "$DIR/base" "$DIR/out"
+        done
+    fi
+    # the filters against the records of the default mode
+    grep '"space_id":3,' "$DIR/base" > "$DIR/expected"
+    for mode in "-P 3" "-P 3 -m" "-P 3 -j 3"; do
+        "$RLR" -o json $mode "$log" > "$DIR/out"
+        check "$(basename "$log") $mode" "$DIR/expected" "$DIR/out"
+    done
+    grep '"page_no":42,' "$DIR/base" > "$DIR/expected"
+    "$RLR" -o json -N 42 "$log" > "$DIR/out"
+    check "$(basename "$log") -N 42" "$DIR/expected" "$DIR/out"
+    grep -E '"type":"MLOG_(WRITE_STRING|2BYTES)"' "$DIR/base" > "$DIR/expected"
+    "$RLR" -o json -t WRITE_STRING,2BYTES "$log" > "$DIR/out"
+    check "$(basename "$log") -t WRITE_STRING,2BYTES" "$DIR/expected" "$DIR/out"
+}
+
+gen() {
+    "$GEN" "$@" > /dev/null || { echo "gen_log $* failed"; exit 2; }
+}
+
+gen -s 4M -r 1 "$DIR/plain"
+# starts with the tail of an mtr, within the first block and across blocks
+gen -s 4M -r 2 -p 100 "$DIR/partial"
+gen -s 4M -r 3 -p 700 -l 400 "$DIR/partial_blocks"
+gen -s 4M -r 4 -p 100 -c 5.7 "$DIR/checkpoint57"
+# mtrs run across the files: the second and third start inside one
+gen -s 2M -r 5 -l 2000 "$DIR/g0" "$DIR/g1" "$DIR/g2"
+
+modes "$DIR/plain" 1
+modes "$DIR/partial" 1
+modes "$DIR/partial_blocks" 1
+modes "$DIR/checkpoint57" 1
+modes "$DIR/g1" 0
+modes "$DIR/g2" 0
+
+"$RLR" -o json "$DIR/g0" "$DIR/g1" "$DIR/g2" > "$DIR/base"
+for mode in "-m" "-b 4K" "-m -b 4K" "-M"; do
+    "$RLR" -o json $mode "$DIR/g0" "$DIR/g1" "$DIR/g2" > "$DIR/out"
+    check "group $mode" "$DIR/base" "$DIR/out"
+done
+
+exit $failed
@@ -0,0 +1,730 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <strings.h>
+#include <locale.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "redo_log_reader.h"
+
+/* --follow without inotify: poll the log every 1ms while it grows, backing
+ * off to 100ms while it does not; with inotify, the longest wait */
+#define FOLLOW_MIN_POLL_MS 1
+#define FOLLOW_MAX_POLL_MS 100
+
+/* upper bounds of --threads, --prefetch and --cache-pages (16G of pages) */
+#define MAX_THREADS 256
+#define MAX_PREFETCH_DEPTH 64
+#define MAX_CACHE_PAGES (1 << 20)
+
+/* set by SIGUSR1: print the counters (and the profile) to stderr at the
+ * next record */
+static volatile sig_atomic_t stat_requested;
+
+/* a slice of the log parsed by one thread in parallel mode */
+typedef struct parse_range_t {
+    const char* path;
+    const reader_opt_t* opt;
+    off_t start;            /* file offset of the first record */
+    off_t end;              /* offset of the first record of the next range */
+    uint64_t lsn;           /* LSN of the first record */
+    char* out;              /* output of the range */
+    size_t out_len;
+    io_stat stats;
+    uint64_t records;
+    uint64_t type_records[MLOG_BIGGEST_TYPE + 1];
+    uint64_t filtered;
+    uint64_t ticks[N_PHASES];   /* --profile, see prof_estimate */
+    log_stat_t* log_stat;   /* --stats */
+    int by_mtr;
+    off_t short_block;      /* with --stop-short, -1: none in the range */
+    pthread_t thread;
+} parse_range_t;
+
+/* a slice of a file checked by one thread in verify mode */
+typedef struct verify_range_t {
+    const reader_t* reader;
+    off_t from;
+    off_t to;
+    verify_stat stat;
+    pthread_t thread;
+} verify_range_t;
+
+static void show_usages(void);
+static void request_stat(int);
+static void check_stat_request(reader_t*);
+static int parse_types(const char*, reader_opt_t*);
+static int parse_count(const char*, long, long, long*);
+static void print_records(reader_t*, page_index_t*, log_stat_t*, apply_t*, int);
+static void print_record(reader_t*, const s_mtr_t*, page_index_t*, log_stat_t*);
+static void parse_parallel(reader_t*, const char*, int, log_stat_t*, int);
+static void print_apply_plan(reader_t*, const page_index_t*);
+static void follow_records(reader_t*, char* const*, int, int);
+static void* parse_range(void*);
+static int verify_files(char* const*, int, const reader_opt_t*, int);
+static void* verify_range(void*);
+
+int main(int argc, char* argv[]) {
+    reader_opt_t opt;
+    reader_t* reader;
+
+    setlocale(LC_ALL, "en_US.utf8");
+    reader_init_opt(&opt);
+    const char* dummy = getenv("RLR_DBG");
+    if (dummy) opt.log_level = atoi(dummy);
+
+    static const struct option long_options[] = {
+        { "mmap", no_argument, NULL, 'm' },
+        { "buffer-size", required_argument, NULL, 'b' },
+        { "prefetch", required_argument, NULL, 'a' },
+        { "threads", required_argument, NULL, 'j' },
+        { "format", required_argument, NULL, 'o' },
+        { "full-dump", no_argument, NULL, 'x' },
+        { "quiet", no_argument, NULL, 'q' },
+        { "group", no_argument, NULL, 'g' },
+        { "checkpoint", no_argument, NULL, 'c' },
+        { "stop-short", no_argument, NULL, 's' },
+        { "from-lsn", required_argument, NULL, 'F' },
+        { "to-lsn", required_argument, NULL, 'T' },
+        { "index", required_argument, NULL, 'i' },
+        { "build-index", required_argument, NULL, 'I' },
+        { "index-interval", required_argument, NULL, 'n' },
+        { "verify", optional_argument, NULL, 'V' },
+        { "top-pages", required_argument, NULL, 'p' },
+        { "stats", no_argument, NULL, 'S' },
+        { "mtr", no_argument, NULL, 'M' },
+        { "apply-plan", no_argument, NULL, 'R' },
+        { "apply", required_argument, NULL, 'A' },
+        { "cache-pages", required_argument, NULL, 'C' },
+        { "follow", no_argument, NULL, 'f' },
+        { "space", required_argument, NULL, 'P' },
+        { "page", required_argument, NULL, 'N' },
+        { "type", required_argument, NULL, 't' },
+        { "profile", no_argument, NULL, 'z' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt_char, n_threads = 1, quiet = 0, group = 0, verify = 0, by_mtr = 0;
+    int index_interval = INDEX_INTERVAL;
+    size_t top_pages = 0, i;
+    int apply_plan = 0, follow = 0;
+    long count;
+    size_t cache_pages = APPLY_CACHE_PAGES;
+    const char* apply_path = NULL;
+    apply_t* apply = NULL;
+    page_index_t pages;
+    page_stat_t** list;
+    log_stat_t log_stat, *stat = NULL;
+    const char *index_path = NULL, *build_index_path = NULL;
+    block_index_t index;
+    const index_entry_t* entry;
+    struct sigaction action;
+    while ((opt_char = getopt_long(argc, argv, "mb:a:j:o:xqgcsF:T:i:I:n:V::p:SMRA:C:fP:N:t:z",
+                    long_options, NULL)) != -1) {
+        switch (opt_char) {
+            case 'm': opt.use_mmap = 1; break;
+            case 'a':
+                if (!parse_count(optarg, 0, MAX_PREFETCH_DEPTH, &count)) {
+                    printf("--prefetch must be a number from 0 to %d\n",
+                            MAX_PREFETCH_DEPTH);
+                    return 1;
+                }
+                opt.prefetch_depth = count;
+                break;
+            case 'j':
+                if (!parse_count(optarg, 1, MAX_THREADS, &count)) {
+                    printf("--threads must be a number from 1 to %d\n", MAX_THREADS);
+                    return 1;
+                }
+                n_threads = count;
+                break;
+            case 'x': opt.hexdump_full = 1; break;
+            case 'q': quiet = 1; break;
+            case 'g': group = 1; break;
+            case 'c': opt.from_checkpoint = 1; break;
+            case 's': opt.stop_at_short_block = 1; break;
+            case 'F': opt.from_lsn = strtoull(optarg, NULL, 10); break;
+            case 'T': opt.to_lsn = strtoull(optarg, NULL, 10); break;
+            case 'i': index_path = optarg; break;
+            case 'I': build_index_path = optarg; break;
+            case 'n':
+                if (!parse_count(optarg, 1, INT_MAX, &count)) {
+                    printf("--index-interval must be a number from 1 to %d\n", INT_MAX);
+                    return 1;
+                }
+                index_interval = count;
+                break;
+            case 'p': top_pages = strtoul(optarg, NULL, 10); break;
+            case 'S': stat = &log_stat; break;
+            case 'M': by_mtr = 1; break;
+            case 'R': apply_plan = 1; break;
+            case 'A': apply_path = optarg; break;
+            case 'C':
+                if (!parse_count(optarg, 1, MAX_CACHE_PAGES, &count)) {
+                    printf("--cache-pages must be a number from 1 to %d\n",
+                            MAX_CACHE_PAGES);
+                    return 1;
+                }
+                cache_pages = count;
+                break;
+            case 'f': follow = 1; break;
+            case 'z': opt.profile = 1; break;
+            case 'P':
+                opt.filter_space = 1;
+                opt.space_id = strtoul(optarg, NULL, 10);
+                break;
+            case 'N':
+                opt.filter_page = 1;
+                opt.page_no = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                if (!parse_types(optarg, &opt)) {
+                    printf("unknown record type in %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'V':
+                verify = 1;
+                if (!optarg) break;
+                if (!strcmp(optarg, "crc32")) opt.checksum = CHECKSUM_CRC32;
+                else if (!strcmp(optarg, "innodb")) opt.checksum = CHECKSUM_INNODB;
+                else if (strcmp(optarg, "any")) {
+                    show_usages();
+                    return 1;
+                }
+                break;
+            case 'o':
+                if (!strcmp(optarg, "json")) opt.output_format = OUTPUT_JSON;
+                else if (!strcmp(optarg, "binary")) opt.output_format = OUTPUT_BINARY;
+                else if (strcmp(optarg, "text")) {
+                    show_usages();
+                    return 1;
+                }
+                break;
+            case 'b':
+                opt.buffer_size = parse_size(optarg);
+                if (opt.buffer_size == -1) {
+                    printf("invalid buffer size %s\n", optarg);
+                    return 1;
+                }
+                if (opt.buffer_size < MIN_MEMORY_BUFFER_SIZE) {
+                    printf("buffer size must be at least %d bytes\n",
+                            MIN_MEMORY_BUFFER_SIZE);
+                    return 1;
+                }
+                break;
+            default:
+                show_usages();
+                return 1;
+        }
+    }
+    if (optind == argc) {
+        show_usages();
+        return 1;
+    }
+    if (verify) return verify_files(argv + optind, argc - optind, &opt, n_threads);
+    /* more than one file is always a group */
+    if (argc - optind > 1) group = 1;
+    if (group && n_threads > 1) {
+        printf("--threads is not supported for a log group\n");
+        return 1;
+    }
+    if (build_index_path && n_threads > 1) {
+        printf("--build-index is not supported with --threads\n");
+        return 1;
+    }
+    if ((top_pages || apply_plan || apply_path) && n_threads > 1) {
+        printf("--top-pages, --apply-plan and --apply are not supported with --threads\n");
+        return 1;
+    }
+    if (follow && (n_threads > 1 || build_index_path || top_pages || stat
+                || apply_plan || apply_path)) {
+        printf("--follow only prints records, it does not go with --threads, "
+                "--build-index or the summaries\n");
+        return 1;
+    }
+    /* the log ends at the block being written, or at a block read while
+     * it was written; reads are synchronous, so the blocks are read again
+     * after each write */
+    if (follow) {
+        opt.stop_at_short_block = 1;
+        opt.stop_at_bad_block = 1;
+        opt.prefetch_depth = 0;
+    }
+    /* recovery only hashes and applies complete mini-transactions */
+    if (apply_plan || apply_path) by_mtr = 1;
+    /* structured output replaces the text output, quiet mode only counts,
+     * the summaries replace the records */
+    if (quiet || top_pages || stat || apply_path) opt.output_format = OUTPUT_TEXT;
+    if (opt.output_format != OUTPUT_TEXT || quiet) opt.log_level = -1;
+
+    if (group) reader = reader_open_group(argv + optind, argc - optind, &opt);
+    else reader = reader_open(argv[optind], &opt);
+    if (!reader) return 2;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stat;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+    show_log_header(reader, &reader->header);
+    if (group || opt.from_checkpoint) show_checkpoint(reader, &reader->checkpoint);
+
+    /* start at the last indexed record group before from_lsn */
+    if (index_path) {
+        if (!read_index(&index, index_path)) return 2;
+        entry = find_index_entry(&index, opt.from_lsn);
+        if (entry && entry->offset > reader->start_offset)
+            reader_seek_index(reader, entry);
+        free_index(&index);
+    }
+    /* reload the first blocks, which reader_open may have read already */
+    if (build_index_path) {
+        memset(&index, 0, sizeof(index));
+        index.interval = index_interval;
+        reader->index = &index;
+        reader_seek(reader, reader->start_offset);
+    }
+
+    if ((top_pages || apply_plan) && !page_index_init(&pages)) return 2;
+    if (apply_path && !(apply = apply_open(apply_path, cache_pages))) return 2;
+    pages.keep_records = apply_plan;
+    if (stat) memset(stat, 0, sizeof(*stat));
+    if (follow) {
+        follow_records(reader, argv + optind, argc - optind, by_mtr);
+    } else if (n_threads > 1) {
+        parse_parallel(reader, argv[optind], n_threads, stat, by_mtr);
+    } else {
+        print_records(reader, top_pages || apply_plan ? &pages : NULL, stat, apply,
+                by_mtr);
+    }
+
+    if (build_index_path) {
+        if (!write_index(&index, build_index_path)) return 2;
+        reader->index = NULL;
+    }
+
+    if (apply_plan) print_apply_plan(reader, &pages);
+    if (quiet) reader->opt.log_level = 0;
+    if (apply_plan)
+        print_log(reader, 0, "apply plan: %lu page batches, memory %lu bytes "
+                "(hash table %lu, records %lu)\n", (unsigned long)pages.n,
+                (unsigned long)(pages.size * sizeof(*pages.slots) + pages.arena.total),
+                (unsigned long)(pages.size * sizeof(*pages.slots)),
+                (unsigned long)pages.arena.total);
+    if (top_pages) {
+        print_log(reader, 0, "============= HOTTEST PAGES ===============\n");
+        list = page_index_pages(&pages, PAGE_ORDER_RECORDS);
+        for (i=0; i<top_pages && i<pages.n; ++i) show_page_stat(reader, list[i]);
+        print_log(reader, 0, "pages: %lu\n", (unsigned long)pages.n);
+        free(list);
+    }
+    if (top_pages || apply_plan) page_index_free(&pages);
+    if (apply) {
+        if (!apply_flush(apply)) return 2;
+        show_apply_stat(reader, apply);
+        apply_close(apply);
+    }
+    if (stat) show_log_stat(reader, stat);
+    /* with the counts, so -q prints it too */
+    if (build_index_path) {
+        print_log(reader, 0, "index entries: %lu\n", (unsigned long)index.n);
+        free_index(&index);
+    }
+    show_io_stat(reader);
+    if (opt.profile) show_prof_stat(reader, stderr);
+    print_log(reader, 0, "done");
+    reader_close(reader);
+    return 0;
+}
+
+/* print the records, or only add them to pages and stat; by_mtr only
+ * takes complete mini-transactions, which apply (with by_mtr) writes into
+ * its tablespace */
+static void print_records(reader_t* reader, page_index_t* pages, log_stat_t* stat,
+        apply_t* apply, int by_mtr) {
+    mtr_group_t group;
+    s_mtr_t mtr;
+    size_t i;
+
+    if (!by_mtr) {
+        while (reader_next_record(reader, &mtr) > 0) {
+            check_stat_request(reader);
+            print_record(reader, &mtr, pages, stat);
+        }
+    } else {
+        memset(&group, 0, sizeof(group));
+        while (reader_next_mtr(reader, &group) > 0) {
+            check_stat_request(reader);
+            if (apply && !apply_mtr(apply, &group)) exit(2);
+            if (!pages && !stat && (apply || reader->opt.output_format == OUTPUT_TEXT)) {
+                if (!apply && reader->opt.log_level >= 0) show_mtr_group(reader, &group);
+                continue;
+            }
+            for (i=0; i<group.n; ++i)
+                print_record(reader, &group.recs[i], pages, stat);
+        }
+        free_mtr_group(&group);
+    }
+    reader->log_indent = 0;
+    flush_records(reader);
+}
+
+static void print_record(reader_t* reader, const s_mtr_t* mtr, page_index_t* pages,
+        log_stat_t* stat) {
+    if (pages || stat) {
+        if (pages) page_index_add(pages, mtr);
+        if (stat) log_stat_add(stat, mtr);
+    } else if (reader->opt.output_format != OUTPUT_TEXT)
+        emit_record(reader, mtr);
+    else if (reader->opt.log_level >= 0)
+        show_mtr(reader, mtr);
+}
+
+/* the records hashed by page as recv_sys has them before they are applied:
+ * one batch per page in page order, the records of a batch in LSN order */
+static void print_apply_plan(reader_t* reader, const page_index_t* pages) {
+    page_stat_t** list = page_index_pages(pages, PAGE_ORDER_ID);
+    const recv_t* recv;
+    size_t i;
+
+    for (i=0; i<pages->n; ++i) {
+        if (reader->opt.output_format == OUTPUT_TEXT) {
+            show_page_recs(reader, list[i]);
+            continue;
+        }
+        for (recv = list[i]->recs; recv; recv = recv->next)
+            emit_record(reader, &recv->mtr);
+    }
+    reader->log_indent = 0;
+    flush_records(reader);
+    free(list);
+}
+
+/* print the records up to the end of the log, wait for mysqld to write
+ * more and go on at the first record (or mtr) that was not complete, which
+ * reads the block being written again. inotify wakes the reader up on a
+ * write; without it the files are polled. Runs until killed */
+static void follow_records(reader_t* reader, char* const* paths, int n_paths,
+        int by_mtr) {
+    struct pollfd notify;
+    char events[4096];
+    int i, timeout = FOLLOW_MIN_POLL_MS;
+    uint64_t records;
+
+    notify.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    notify.events = POLLIN;
+    for (i=0; i<n_paths && notify.fd != -1; ++i) {
+        if (inotify_add_watch(notify.fd, paths[i], IN_MODIFY) != -1) continue;
+        perror("inotify_add_watch");
+        close(notify.fd);
+        notify.fd = -1;
+    }
+    while (1) {
+        records = reader->records;
+        print_records(reader, NULL, NULL, NULL, by_mtr);
+        fflush(reader->opt.out);
+        if (notify.fd != -1) timeout = FOLLOW_MAX_POLL_MS;
+        else if (reader->records != records) timeout = FOLLOW_MIN_POLL_MS;
+        else if (timeout < FOLLOW_MAX_POLL_MS) timeout *= 2;
+        /* a negative fd is ignored: poll only sleeps */
+        if (poll(&notify, 1, timeout) > 0)
+            while (read(notify.fd, events, sizeof(events)) > 0);
+        check_stat_request(reader);
+        reader_seek(reader, reader->resume_offset);
+    }
+}
+
+/* each range has a reader of its own, writing into a memory stream */
+static void* parse_range(void* arg) {
+    parse_range_t* range = arg;
+    reader_opt_t opt = *range->opt;
+    reader_t* reader;
+
+    range->out = NULL;
+    opt.out = open_memstream(&range->out, &range->out_len);
+    if (!opt.out) {
+        perror("open_memstream");
+        exit(2);
+    }
+    reader = reader_open(range->path, &opt);
+    if (!reader) exit(2);
+    reader->end_offset = range->end;
+    reader_seek(reader, range->start);
+    print_records(reader, NULL, range->log_stat, NULL, range->by_mtr);
+
+    range->stats = reader->stats;
+    range->records = reader->records;
+    memcpy(range->type_records, reader->type_records, sizeof(range->type_records));
+    range->filtered = reader->filtered;
+    if (opt.profile) prof_estimate(&reader->prof, prof_ticks(), range->ticks);
+    range->short_block = reader->short_block;
+    reader_close(reader);
+    fclose(opt.out);
+    return NULL;
+}
+
+static int cmp_range_lsn(const void* a, const void* b) {
+    const parse_range_t *ra = a, *rb = b;
+    return ra->lsn < rb->lsn ? -1 : ra->lsn > rb->lsn;
+}
+
+/* split the log into n ranges at record group boundaries, parse them in
+ * parallel and print the results in LSN order */
+static void parse_parallel(reader_t* reader, const char* path, int n,
+        log_stat_t* stat, int by_mtr) {
+    struct stat st;
+    block_hdr block_header;
+    off_t size, offset, end;
+    int i, j, n_ranges = 0;
+    uint64_t ticks;
+
+    if (fstat(reader->fd, &st) == -1) {
+        perror("fstat");
+        exit(2);
+    }
+    size = st.st_size - LOG_FILE_HDR_SIZE;
+
+    parse_range_t* ranges = calloc(n, sizeof(*ranges));
+    if (!ranges) {
+        perror("malloc");
+        exit(2);
+    }
+    for (i=0; i<n; ++i) {
+        offset = LOG_FILE_HDR_SIZE + size / n * i;
+        if (i == 0) {
+            offset = reader->start_offset;
+            if (!find_block_header(reader, offset - offset % OS_FILE_LOG_BLOCK_SIZE,
+                        &block_header))
+                continue;
+        } else {
+            offset = find_resync_block(reader, offset, &block_header);
+            if (offset == -1) break;
+            offset += block_header.first_rec_group;
+            if (n_ranges && offset <= ranges[n_ranges - 1].start) continue;
+        }
+        ranges[n_ranges].path = path;
+        ranges[n_ranges].by_mtr = by_mtr;
+        if (stat) {
+            ranges[n_ranges].log_stat = calloc(1, sizeof(*stat));
+            if (!ranges[n_ranges].log_stat) {
+                perror("malloc");
+                exit(2);
+            }
+        }
+        ranges[n_ranges].opt = &reader->opt;
+        ranges[n_ranges].start = offset;
+        ranges[n_ranges].lsn = block_no_to_lsn(reader, block_header.block_no)
+            + offset % OS_FILE_LOG_BLOCK_SIZE;
+        if (n_ranges) ranges[n_ranges - 1].end = offset;
+        ++n_ranges;
+    }
+
+    ticks = prof_ticks();
+    for (i=0; i<n_ranges; ++i) {
+        if (pthread_create(&ranges[i].thread, NULL, parse_range, &ranges[i])) {
+            perror("pthread_create");
+            exit(2);
+        }
+    }
+    for (i=0; i<n_ranges; ++i) {
+        pthread_join(ranges[i].thread, NULL);
+        reader->stats.blocks += ranges[i].stats.blocks;
+        reader->stats.syscalls += ranges[i].stats.syscalls;
+        reader->stats.bytes += ranges[i].stats.bytes;
+        reader->stats.refills += ranges[i].stats.refills;
+        reader->stats.compacted += ranges[i].stats.compacted;
+        for (j=0; j<N_PHASES; ++j) reader->prof.merged[j] += ranges[i].ticks[j];
+    }
+    /* the phases are those of the threads, not the wait for them */
+    reader->prof.idle += prof_ticks() - ticks;
+    /* the ranges after the one with the short block are past the end; a
+     * reader may have seen the block when reading ahead of its range */
+    for (i=0; i<n_ranges; ++i) {
+        end = ranges[i].end - ranges[i].end % OS_FILE_LOG_BLOCK_SIZE;
+        reader->records += ranges[i].records;
+        for (j=0; j<=MLOG_BIGGEST_TYPE; ++j)
+            reader->type_records[j] += ranges[i].type_records[j];
+        reader->filtered += ranges[i].filtered;
+        if (stat) log_stat_merge(stat, ranges[i].log_stat);
+        if (ranges[i].short_block != -1
+            && (!ranges[i].end || ranges[i].short_block < end))
+            break;
+    }
+    while (++i < n_ranges) ranges[i].out_len = 0;
+    for (i=0; i<n_ranges; ++i) free(ranges[i].log_stat);
+
+    qsort(ranges, n_ranges, sizeof(*ranges), cmp_range_lsn);
+    for (i=0; i<n_ranges; ++i) {
+        fwrite(ranges[i].out, 1, ranges[i].out_len, reader->opt.out);
+        free(ranges[i].out);
+    }
+    free(ranges);
+}
+
+static void* verify_range(void* arg) {
+    verify_range_t* range = arg;
+    verify_blocks(range->reader, 0, range->from, range->to, &range->stat);
+    return NULL;
+}
+
+/* check the block checksums of each file with n threads, print the counts
+ * and the first bad block; 3 if there is one */
+static int verify_files(char* const* paths, int n_paths, const reader_opt_t* opt,
+        int n) {
+    verify_range_t* ranges = calloc(n, sizeof(*ranges));
+    verify_stat total;
+    reader_t* reader;
+    off_t size;
+    int i, file, first_bad = -1;
+
+    if (!ranges) {
+        perror("malloc");
+        exit(2);
+    }
+    memset(&total, 0, sizeof(total));
+    for (file=0; file<n_paths; ++file) {
+        reader = reader_open(paths[file], opt);
+        if (!reader) exit(2);
+        size = reader->log_size / OS_FILE_LOG_BLOCK_SIZE;
+        for (i=0; i<n; ++i) {
+            memset(&ranges[i].stat, 0, sizeof(ranges[i].stat));
+            ranges[i].reader = reader;
+            ranges[i].from = size * i / n * OS_FILE_LOG_BLOCK_SIZE;
+            ranges[i].to = size * (i + 1) / n * OS_FILE_LOG_BLOCK_SIZE;
+            if (pthread_create(&ranges[i].thread, NULL, verify_range, &ranges[i])) {
+                perror("pthread_create");
+                exit(2);
+            }
+        }
+        for (i=0; i<n; ++i) {
+            pthread_join(ranges[i].thread, NULL);
+            total.blocks += ranges[i].stat.blocks;
+            total.empty += ranges[i].stat.empty;
+            total.syscalls += ranges[i].stat.syscalls;
+            total.bad += ranges[i].stat.bad;
+            /* the ranges are in file order: the first with a bad block */
+            if (ranges[i].stat.bad && first_bad == -1) {
+                first_bad = file;
+                total.first_bad_offset = ranges[i].stat.first_bad_offset;
+                total.first_bad_no = ranges[i].stat.first_bad_no;
+            }
+        }
+        reader_close(reader);
+    }
+    free(ranges);
+
+    printf("blocks: %"PRIu64", empty: %"PRIu64", bad: %"PRIu64
+            ", read syscalls: %"PRIu64"\n",
+            total.blocks, total.empty, total.bad, total.syscalls);
+    if (first_bad == -1) return 0;
+    printf("first bad block: %s offset %lld block no %"PRIu32"\n",
+            paths[first_bad], (long long)total.first_bad_offset, total.first_bad_no);
+    return 3;
+}
+
+/* a decimal number from min to max, without anything after it */
+static int parse_count(const char* str, long min, long max, long* val) {
+    char* end;
+    errno = 0;
+    *val = strtol(str, &end, 10);
+    return end != str && !*end && errno != ERANGE && *val >= min && *val <= max;
+}
+
+/* --type: a comma separated list of type numbers or names, with or
+ * without the MLOG_ prefix */
+static int parse_types(const char* list, reader_opt_t* opt) {
+    char name[64];
+    const char *end, *known;
+    size_t len;
+    int type;
+
+    opt->filter_type = 1;
+    while (*list) {
+        end = strchr(list, ',');
+        if (!end) end = list + strlen(list);
+        len = end - list;
+        if (len == 0 || len >= sizeof(name)) return 0;
+        memcpy(name, list, len);
+        name[len] = '\0';
+        list = *end ? end + 1 : end;
+
+        if (name[0] >= '0' && name[0] <= '9') {
+            type = atoi(name);
+            if (type > MLOG_BIGGEST_TYPE) return 0;
+        } else {
+            for (type=0; type<=MLOG_BIGGEST_TYPE; ++type) {
+                known = log_type_name(type);
+                if (strncmp(known, "MLOG_", 5)) continue;
+                if (!strcasecmp(name, known) || !strcasecmp(name, known + 5))
+                    break;
+            }
+            if (type > MLOG_BIGGEST_TYPE) return 0;
+        }
+        opt->types[type] = 1;
+    }
+    return 1;
+}
+
+static void request_stat(int sig) {
+    (void)sig;
+    stat_requested = 1;
+}
+
+/* with --threads, the range that sees the request first prints its own */
+static void check_stat_request(reader_t* reader) {
+    if (!stat_requested) return;
+    stat_requested = 0;
+    show_prof_stat(reader, stderr);
+}
+
+static void show_usages(void) {
+    printf("Usages: redo-log-reader [options] /path/to/ib_logfile0 [ib_logfile1 ...]\n"
+           "  -m, --mmap               map the log file and parse blocks in place\n"
+           "  -b, --buffer-size SIZE   read buffer size, e.g. 4M (default %dK)\n"
+           "  -a, --prefetch N         keep N buffer-sized reads in flight\n"
+           "  -j, --threads N          parse N ranges of the file in parallel\n"
+           "  -o, --format FORMAT      text (default), json (one record per line)\n"
+           "                           or binary (length-prefixed records)\n"
+           "  -x, --full-dump          hexdump whole bodies instead of %d bytes\n"
+           "  -q, --quiet              parse without output, print the counts only\n"
+           "  -g, --group              read the files as a log group from the latest\n"
+           "                           checkpoint (the default with several files)\n"
+           "  -c, --checkpoint         start at the latest checkpoint of the file\n"
+           "  -s, --stop-short         stop after the first block that is not full\n"
+           "  -F, --from-lsn LSN       skip the records before LSN\n"
+           "  -T, --to-lsn LSN         stop at the first record at or after LSN\n"
+           "  -i, --index FILE         start at the record group FILE has before\n"
+           "                           --from-lsn\n"
+           "  -I, --build-index FILE   write a block index to FILE while parsing\n"
+           "  -n, --index-interval N   blocks between index entries (default %d)\n"
+           "  -V, --verify[=ALG]       only check the block checksums: crc32, innodb\n"
+           "                           or any (default), with --threads N threads\n"
+           "  -p, --top-pages N        print the N pages with the most records and\n"
+           "                           their record types instead of the records\n"
+           "  -S, --stats              print the redo volume by record type and the\n"
+           "                           mini-transaction sizes instead of the records\n"
+           "  -M, --mtr                group the records by mini-transaction and drop\n"
+           "                           an incomplete one at the end\n"
+           "  -R, --apply-plan         hash the records by page as recovery does and\n"
+           "                           print them page by page, in LSN order\n"
+           "  -A, --apply FILE.ibd     write the MLOG_nBYTES and MLOG_WRITE_STRING\n"
+           "                           records of its space into the tablespace\n"
+           "  -C, --cache-pages N      pages cached by --apply (default %d)\n"
+           "  -f, --follow             keep printing the records mysqld writes\n"
+           "  -P, --space ID           only the records of space ID\n"
+           "  -N, --page NO            only the records of page NO\n"
+           "  -t, --type TYPE,...      only the records of these types (numbers, or\n"
+           "                           names such as MLOG_WRITE_STRING or WRITE_STRING)\n"
+           "  -z, --profile            time the read, compaction, decoding and output\n"
+           "                           and print it with the counters at the end (also\n"
+           "                           printed, with or without it, on SIGUSR1)\n",
+           MEMORY_BUFFER_SIZE >> 10, HEXDUMP_MAX_LEN, INDEX_INTERVAL, APPLY_CACHE_PAGES);
+}
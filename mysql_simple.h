@@ -77,6 +77,32 @@ typedef unsigned char byte;
                     header */
 #define LOG_FILE_HDR_SIZE   (4 * OS_FILE_LOG_BLOCK_SIZE)
 
+/* Offsets for a checkpoint field */
+#define LOG_CHECKPOINT_NO       0
+#define LOG_CHECKPOINT_LSN      8
+#define LOG_CHECKPOINT_OFFSET_LOW32 16
+#define LOG_CHECKPOINT_LOG_BUF_SIZE 20
+#define LOG_CHECKPOINT_ARCHIVED_LSN 24
+#define LOG_CHECKPOINT_GROUP_ARRAY  32
+#define LOG_MAX_N_GROUPS        32
+#define LOG_CHECKPOINT_ARRAY_END    (LOG_CHECKPOINT_GROUP_ARRAY\
+                    + LOG_MAX_N_GROUPS * 8)
+#define LOG_CHECKPOINT_CHECKSUM_1   LOG_CHECKPOINT_ARRAY_END
+#define LOG_CHECKPOINT_CHECKSUM_2   (4 + LOG_CHECKPOINT_ARRAY_END)
+#define LOG_CHECKPOINT_OFFSET_HIGH32    (16 + LOG_CHECKPOINT_ARRAY_END)
+                    /* the high 32 bits of the offset,
+                    0 in logs written before 5.6 */
+#define LOG_CHECKPOINT_SIZE     (20 + LOG_CHECKPOINT_ARRAY_END)
+
+/* Offsets for a checkpoint field of 5.7: a whole block, checked with the
+ * block checksum */
+#define LOG_CHECKPOINT_OFFSET       16  /* 8 bytes */
+#define LOG_CHECKPOINT_BUF_SIZE_57  24
+
+/* ut_fold_ulint_pair */
+#define UT_HASH_RANDOM_MASK     1463735687
+#define UT_HASH_RANDOM_MASK2    1653893711
+
 /* Offsets of a log block trailer from the end of the block */
 #define LOG_BLOCK_CHECKSUM  4   /* 4 byte checksum of the log block
                     contents; in InnoDB versions
@@ -84,6 +110,9 @@ typedef unsigned char byte;
                     checksum but the same value as
                     .._HDR_NO */
 #define LOG_BLOCK_TRL_SIZE  4   /* trailer size in bytes */
+#define LOG_NO_CHECKSUM_MAGIC   0xDEADBEEFUL
+                    /* the checksum with
+                    innodb_log_checksum_algorithm=none */
 
 /* mtr0mtr.h */
 
@@ -243,7 +272,24 @@ functions).  The page number parameter was originally written as 0. @{ */
 /* @} */
 
 #define DATA_ROLL_PTR_LEN 7
+#define REC_NODE_PTR_SIZE 4 /* child page number of a node pointer */
+#define BTR_EXTERN_FIELD_REF_SIZE 20    /* reference to an externally
+                    stored column */
 
+/* univ.i, fil0fil.h */
+#define UNIV_PAGE_SIZE  16384
+#define FIL_PAGE_SPACE_OR_CHKSUM 0  /* checksum of the page */
+#define FIL_PAGE_OFFSET     4   /* page number */
+#define FIL_PAGE_LSN        16  /* lsn of the end of the newest
+                    modification log record to the page */
+#define FIL_PAGE_FILE_FLUSH_LSN 26  /* flushed lsn, only in page 0 of
+                    the system tablespace */
+#define FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID 34 /* space id of the page */
+#define FIL_PAGE_DATA       38  /* start of the data on the page */
+#define FIL_PAGE_END_LSN_OLD_CHKSUM 8   /* the low 4 bytes of this are
+                    used to store the page checksum, the
+                    last 4 bytes should be identical to
+                    the last 4 bytes of FIL_PAGE_LSN */
 
 #define LOG_BLOCK_DATA_SIZE (OS_FILE_LOG_BLOCK_SIZE \
         - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE)
@@ -5,361 +5,1061 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
-#include <locale.h>
 #include <wchar.h>
 #include <ctype.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "redo_log_reader.h"
 
-int main(int argc, char* argv[]) {
-    setlocale(LC_ALL, "en_US.utf8");
-    const char* dummy = getenv("RLR_DBG");
-    if (dummy) log_level = atoi(dummy);
+static byte* write_be(byte* dst, uint64_t val, int n) {
+    while (n--) *dst++ = (byte)(val >> BYTE_N(n));
+    return dst;
+}
 
-    if (argc != 2) {
-        show_usages();
-        return 1;
-    }
+void reader_init_opt(reader_opt_t* opt) {
+    memset(opt, 0, sizeof(*opt));
+    opt->buffer_size = MEMORY_BUFFER_SIZE;
+    opt->output_format = OUTPUT_TEXT;
+}
 
-    fd = open(argv[1], O_RDONLY);
-    if (fd == -1) {
+/* open a log file and read its header; the reader is positioned at the
+ * first block. NULL on failure, with the reason printed */
+reader_t* reader_open(const char* path, const reader_opt_t* opt) {
+    reader_t* reader = calloc(1, sizeof(*reader));
+    if (!reader) {
+        perror("malloc");
+        return NULL;
+    }
+    reader->opt = *opt;
+    if (!reader->opt.out) reader->opt.out = stdout;
+    clock_gettime(CLOCK_MONOTONIC, &reader->prof.start);
+    reader->prof.start_ticks = prof_ticks();
+    if (reader->opt.use_mmap) reader->opt.prefetch_depth = 0;
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd == -1) {
         perror("open");
-        return 2;
+        free(reader);
+        return NULL;
+    }
+    reader->n_files = 1;
+    reader->fds = &reader->fd;
+    reader->maps = &reader->log_map;
+    if (!parse_log_header(reader)) {
+        fprintf(stderr, "%s: log file header is truncated\n", path);
+        goto fail;
+    }
+    reader->start_lsn = reader->header.start_lsn;
+    if (!stat_log_file(reader, reader->fd)) goto fail;
+    if (reader->opt.use_mmap
+        && !(reader->log_map = map_log_file(reader, reader->fd)))
+        goto fail;
+    if (!init_buffer(&reader->buf, reader->opt.buffer_size)) goto fail;
+    reader->short_block = -1;
+
+    /* the checkpoint offset is in the group, so it is only in this file
+     * when the file is the first one */
+    if (reader->opt.from_checkpoint) {
+        if (!read_checkpoint(reader)) {
+            fprintf(stderr, "%s: no valid checkpoint\n", path);
+            goto fail;
+        }
+        if (reader->checkpoint.offset < LOG_FILE_HDR_SIZE
+            || reader->checkpoint.offset >= reader->log_size) {
+            fprintf(stderr, "%s: the checkpoint is in another file of the group, "
+                    "use --group\n", path);
+            goto fail;
+        }
+        reader->start_lsn = reader->checkpoint.lsn;
+        reader->start_offset = reader->checkpoint.offset;
+        reader_seek(reader, reader->start_offset);
     }
+    return reader;
 
-    parse_log_header();
+fail:
+    reader_close(reader);
+    return NULL;
+}
 
-    buf_t mtr_buffer = { .buffer_offset = 0, .buffer_len = 0 };
-    buf_t* mtr_buf = &mtr_buffer;
-    byte* buf_ptr;
-    byte type;
+/* open the files of a log group, in order, as one stream: it starts at the
+ * newest checkpoint and follows the LSNs across the files and around the
+ * end of the last one. File offsets are LSNs in this mode, see locate_block */
+reader_t* reader_open_group(char* const* paths, int n_files,
+        const reader_opt_t* opt) {
+    reader_opt_t group_opt = *opt;
+    reader_t* reader;
+    off_t size;
+    int i;
 
-    s_mtr_t mtr;
-    while (1) {
-        /* block contents: mtr */
-        int flag = 1;
-        while (flag) {
-            clear_mtr(&mtr);
-
-            print_log(1, "DEBUG file offset 0x%08llx buffer(%"PRIu64" / %lu,"
-                    " file start +%llu buffer start +%llu)\n",
-                    B2F(mtr_buf), mtr_buf->buffer_offset, mtr_buf->buffer_len,
-                    mtr_buf->start_file_offset, mtr_buf->start_buffer_offset);
-            buf_ptr = read_buffer_n(&mtr.type, mtr_buf, 1);
-            if (!buf_ptr) goto done;
+    group_opt.prefetch_depth = 0;
+    group_opt.from_checkpoint = 0;
+    reader = reader_open(paths[0], &group_opt);
+    if (!reader) return NULL;
+    size = reader->log_size;
+    reader->group = 1;
+    reader->fds = malloc(n_files * sizeof(*reader->fds));
+    reader->maps = calloc(n_files, sizeof(*reader->maps));
+    if (!reader->fds || !reader->maps) {
+        perror("malloc");
+        goto fail;
+    }
+    reader->fds[0] = reader->fd;
+    reader->maps[0] = reader->log_map;
+    for (i=1; i<n_files; ++i) reader->fds[i] = -1;
+    reader->n_files = n_files;
+
+    for (i=1; i<n_files; ++i) {
+        reader->fds[i] = open(paths[i], O_RDONLY);
+        if (reader->fds[i] == -1) {
+            perror("open");
+            goto fail;
+        }
+        if (!stat_log_file(reader, reader->fds[i])) goto fail;
+        if (reader->log_size != size) {
+            fprintf(stderr, "%s: all files of a log group must have the same size\n",
+                    paths[i]);
+            goto fail;
+        }
+        if (reader->log_map
+            && !(reader->maps[i] = map_log_file(reader, reader->fds[i])))
+            goto fail;
+    }
+    if (size <= LOG_FILE_HDR_SIZE || size % OS_FILE_LOG_BLOCK_SIZE) {
+        fprintf(stderr, "%s: not a log file of a group\n", paths[0]);
+        goto fail;
+    }
 
-            type = mtr.type;
-            if (mtr_is_single_rec(&mtr)) {
-                type &= (byte)~MLOG_SINGLE_REC_FLAG;
-                log_indent = 0;
-            } else {
-                log_indent = 1;
-            }
+    if (!read_checkpoint(reader)) {
+        fprintf(stderr, "%s: no valid checkpoint\n", paths[0]);
+        goto fail;
+    }
+    reader->start_lsn = reader->checkpoint.lsn;
+    reader->start_offset = reader->checkpoint.lsn;
+    reader_seek(reader, reader->start_offset);
+    return reader;
+
+fail:
+    reader_close(reader);
+    return NULL;
+}
 
-            if (type != MLOG_MULTI_REC_END && type != MLOG_DUMMY_RECORD
-                && type != MLOG_CHECKPOINT)
-            {
-                buf_ptr = read_compressed(&mtr.space_id, mtr_buf);
-                if (!buf_ptr) goto done;
+/* continue parsing at a record boundary: offset is the first byte of a
+ * record, or the start of a block to resume at its first record group */
+void reader_seek(reader_t* reader, off_t offset) {
+    buf_t* mtr_buf = &reader->buf;
+    off_t block = offset - offset % OS_FILE_LOG_BLOCK_SIZE;
+    uint64_t ticks;
+
+    mtr_buf->buffer = mtr_buf->memory;
+    mtr_buf->buffer_offset = mtr_buf->buffer_len = 0;
+    mtr_buf->start_buffer_offset = 0;
+    mtr_buf->start_file_offset = block;
+    mtr_buf->mark = -1;
+    reader->file_offset = block;
+    reader->short_block = -1;
+    mtr_buf->at_group = offset == block;
+    if (offset == block) return;
+
+    /* load the block and skip to the record */
+    ticks = PROF_NOW(reader);
+    if (reader->log_map) map_block_into_buffer(reader, 1);
+    else read_block_into_buffer(reader);
+    PROF_ADD(reader, PHASE_READ, ticks);
+    mtr_buf->start_file_offset = block;
+    mtr_buf->start_buffer_offset = 0;
+    mtr_buf->buffer_offset = offset - block - LOG_BLOCK_HDR_SIZE;
+}
 
-                buf_ptr = read_compressed(&mtr.page_no, mtr_buf);
-                if (!buf_ptr) goto done;
-            } else {
-                log_indent = 0;
-            }
+void reader_close(reader_t* reader) {
+    flush_records(reader);
+    if (reader->prefetch) stop_prefetch(reader);
+    free_buffer(&reader->buf);
+    if (reader->group) {
+        int i;
+        for (i=1; i<reader->n_files; ++i) {
+            if (reader->maps[i]) munmap(reader->maps[i], reader->log_size);
+            if (reader->fds[i] != -1) close(reader->fds[i]);
+        }
+        free(reader->fds);
+        free(reader->maps);
+    }
+    if (reader->log_map) munmap(reader->log_map, reader->log_size);
+    close(reader->fd);
+    free(reader->rec_out.data);
+    free(reader->payload_copy.data);
+    free(reader);
+}
 
-            /* if (type != MLOG_1BYTE && type != MLOG_2BYTES */
-            /*         && type != MLOG_4BYTES && type != MLOG_8BYTES) */
-            show_mtr(&mtr);
-
-            /* recv_parse_or_apply_log_rec_body */
-            switch (type) {
-                case MLOG_1BYTE:
-                case MLOG_2BYTES:
-                case MLOG_4BYTES:
-                case MLOG_8BYTES: {
-                    uint16_t page_offset;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
+/* the filters of opt on the record header. Records without a page only
+ * pass a space or page filter as the end of an mtr for reader_next_mtr */
+static int record_passes(const reader_t* reader, byte type, const s_mtr_t* mtr) {
+    const reader_opt_t* opt = &reader->opt;
+    if (type == MLOG_MULTI_REC_END && reader->by_mtr) return 1;
+    if (opt->filter_type && (type > MLOG_BIGGEST_TYPE || !opt->types[type]))
+        return 0;
+    if (type == MLOG_MULTI_REC_END || type == MLOG_DUMMY_RECORD
+        || type == MLOG_CHECKPOINT)
+        return !opt->filter_space && !opt->filter_page;
+    if (opt->filter_space && mtr->space_id != opt->space_id) return 0;
+    if (opt->filter_page && mtr->page_no != opt->page_no) return 0;
+    return 1;
+}
 
-                    print_log(0, "page offset: %"PRIu16" ", page_offset);
-                    if (type == MLOG_8BYTES) {
-                        uint64_t val;
-                        buf_ptr = read_compressed_64(&val, mtr_buf);
-                        if (!buf_ptr) goto done;
-                        print_log(0, "value: %"PRIu64"\n", val);
-                    } else {
-                        uint32_t val;
-                        buf_ptr = read_compressed(&val, mtr_buf);
-                        if (!buf_ptr) goto done;
-                        print_log(0, "value: %"PRIu32"\n", val);
-                    }
-                    break;
-                }
-                case MLOG_REC_INSERT:
-                case MLOG_COMP_REC_INSERT: {
-                    buf_ptr = parse_index(type == MLOG_COMP_REC_INSERT, mtr_buf);
-                    if (!buf_ptr) goto done;
+/* decode the next record into mtr. Nothing is printed or copied unless the
+ * body straddles a refill; format the record with show_mtr or emit_record.
+ * Returns 1 on a record, 0 at the end of the log or at the record starting
+ * at reader->end_offset; reader_seek to reader->resume_offset goes on from
+ * there once the log has grown */
+int reader_next_record(reader_t* reader, s_mtr_t* mtr) {
+    buf_t* mtr_buf = &reader->buf;
+    byte* buf_ptr;
+    byte type;
+    off_t rec_offset, body_offset;
+    int passes;
 
-                    ssize_t bytes = parse_insert_rec(0, mtr_buf);
-                    if (bytes == 0) goto done;
+    /* reader_next_mtr samples whole mtrs */
+    if (!reader->by_mtr) PROF_ENTER(reader);
+    while (1) {
+        clear_mtr(mtr);
+        mtr_buf->mark = -1;
+        if (reader->end_offset && B2F(mtr_buf) >= reader->end_offset) goto done;
+        /* where the record starts: past the last byte loaded once all is
+         * consumed, as B2F is the start of the next block then */
+        if (mtr_buf->buffer_len == 0)
+            reader->resume_offset = reader->file_offset;
+        else if (mtr_buf->buffer_offset < mtr_buf->buffer_len)
+            reader->resume_offset = B2F(mtr_buf);
+        else
+            reader->resume_offset = buf_file_offset(mtr_buf, mtr_buf->buffer_len - 1) + 1;
+
+        print_log(reader, 1, "DEBUG file offset 0x%08llx buffer(%"PRIu64" / %lu,"
+                " file start +%llu buffer start %+lld)\n",
+                B2F(mtr_buf), mtr_buf->buffer_offset, mtr_buf->buffer_len,
+                mtr_buf->start_file_offset, mtr_buf->start_buffer_offset);
+        buf_ptr = read_buffer_n(&mtr->type, reader, 1);
+        if (!buf_ptr) goto done;
+        rec_offset = buf_file_offset(mtr_buf, mtr_buf->buffer_offset - 1);
+        mtr->offset = rec_offset;
+        mtr->lsn = buf_lsn(mtr_buf, mtr_buf->buffer_offset - 1);
+        if (reader->opt.to_lsn && mtr->lsn >= reader->opt.to_lsn) goto done;
+        if (reader->group) mtr->offset = group_offset(reader, mtr->offset);
+
+        type = mtr->type & (byte)~MLOG_SINGLE_REC_FLAG;
+        if (type != MLOG_MULTI_REC_END && type != MLOG_DUMMY_RECORD
+            && type != MLOG_CHECKPOINT)
+        {
+            buf_ptr = read_compressed(&mtr->space_id, reader);
+            if (!buf_ptr) goto done;
 
-                    break;
-                }
-                case MLOG_LIST_END_COPY_CREATED:
-                case MLOG_COMP_LIST_END_COPY_CREATED: {
-                    buf_ptr = parse_index(type == MLOG_COMP_LIST_END_COPY_CREATED, mtr_buf);
+            buf_ptr = read_compressed(&mtr->page_no, reader);
+            if (!buf_ptr) goto done;
+        }
+        body_offset = B2F(mtr_buf);
+        /* a record that is dropped is not kept through refills */
+        passes = record_passes(reader, type, mtr);
+        if (passes) mtr_buf->mark = mtr_buf->buffer_offset;
+
+        /* recv_parse_or_apply_log_rec_body */
+        switch (type) {
+            case MLOG_1BYTE:
+            case MLOG_2BYTES:
+            case MLOG_4BYTES:
+            case MLOG_8BYTES: {
+                if (!read_page_offset(reader, mtr)) goto done;
+                if (type == MLOG_8BYTES) {
+                    buf_ptr = read_compressed_64(&mtr->value, reader);
                     if (!buf_ptr) goto done;
-
-                    uint32_t data_len;
-                    buf_ptr = read_buffer_n(&data_len, mtr_buf, 4);
+                } else {
+                    uint32_t val;
+                    buf_ptr = read_compressed(&val, reader);
                     if (!buf_ptr) goto done;
-
-                    print_log(0, "data_len: %"PRIu32"\n", data_len);
-                    ssize_t bytes_count;
-                    while (data_len > 0) {
-                        bytes_count = parse_insert_rec(1, mtr_buf);
-                        assert(bytes_count > 0 && bytes_count <= data_len);
-                        data_len -= bytes_count;
-                    }
-                    break;
+                    mtr->value = val;
                 }
-                case MLOG_LIST_END_DELETE:
-                case MLOG_COMP_LIST_END_DELETE:
-                case MLOG_LIST_START_DELETE:
-                case MLOG_COMP_LIST_START_DELETE: {
-                    buf_ptr = parse_index(
+                break;
+            }
+            case MLOG_REC_INSERT:
+            case MLOG_COMP_REC_INSERT: {
+                if (!parse_index(type == MLOG_COMP_REC_INSERT, reader, mtr))
+                    goto done;
+                if (!read_page_offset(reader, mtr)) goto done;
+                if (!parse_insert_rec(reader, &mtr->insert)) goto done;
+                break;
+            }
+            case MLOG_LIST_END_COPY_CREATED:
+            case MLOG_COMP_LIST_END_COPY_CREATED: {
+                if (!parse_index(type == MLOG_COMP_LIST_END_COPY_CREATED,
+                            reader, mtr))
+                    goto done;
+
+                /* the records are decoded by show_mtr, see decode_insert_rec */
+                uint32_t data_len;
+                buf_ptr = read_buffer_n(&data_len, reader, 4);
+                if (!buf_ptr) goto done;
+                if (!read_view(&mtr->data, reader, data_len)) goto done;
+                break;
+            }
+            case MLOG_LIST_END_DELETE:
+            case MLOG_COMP_LIST_END_DELETE:
+            case MLOG_LIST_START_DELETE:
+            case MLOG_COMP_LIST_START_DELETE:
+            case MLOG_REC_DELETE:
+            case MLOG_COMP_REC_DELETE: {
+                if (!parse_index(
                             type == MLOG_COMP_LIST_END_DELETE
-                            || type == MLOG_COMP_LIST_START_DELETE,
-                            mtr_buf
-                    );
-                    if (!buf_ptr) goto done;
+                            || type == MLOG_COMP_LIST_START_DELETE
+                            || type == MLOG_COMP_REC_DELETE,
+                            reader, mtr
+                    ))
+                    goto done;
+                if (!read_page_offset(reader, mtr)) goto done;
+                break;
+            }
+            case MLOG_PAGE_REORGANIZE:
+            case MLOG_COMP_PAGE_REORGANIZE: {
+                if (!parse_index(type == MLOG_COMP_PAGE_REORGANIZE, reader, mtr))
+                    goto done;
+                break;
+            }
+            case MLOG_UNDO_INSERT: {
+                uint16_t len;
+                buf_ptr = read_buffer_n(&len, reader, 2);
+                if (!buf_ptr) goto done;
+                if (!read_view(&mtr->data, reader, len)) goto done;
+                break;
+            }
+            case MLOG_REC_UPDATE_IN_PLACE:
+            case MLOG_COMP_REC_UPDATE_IN_PLACE: {
+                mtr_update_t* upd = &mtr->update;
+                if (!parse_index(type == MLOG_COMP_REC_UPDATE_IN_PLACE, reader, mtr))
+                    goto done;
+                buf_ptr = read_buffer_n(&upd->flags, reader, 1);
+                if (!buf_ptr) goto done;
+                if (!parse_trx_id(reader, upd)) goto done;
+                if (!read_page_offset(reader, mtr)) goto done;
+
+                buf_ptr = read_buffer_n(&upd->info_bits, reader, 1);
+                if (!buf_ptr) goto done;
+                buf_ptr = read_compressed(&upd->n_fields, reader);
+                if (!buf_ptr) goto done;
 
-                    uint16_t page_offset;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
+                /* walk the update vector to find its end, show_mtr decodes
+                 * the fields again from the view */
+                uint32_t i, field_no, len;
+                upd->fields.offset = B2F(mtr_buf);
+                for (i=0; i<upd->n_fields; ++i) {
+                    buf_ptr = read_compressed(&field_no, reader);
                     if (!buf_ptr) goto done;
-                    print_log(0, "page offset: %"PRIu16"\n", page_offset);
-                    break;
-                }
-                case MLOG_PAGE_REORGANIZE:
-                case MLOG_COMP_PAGE_REORGANIZE: {
-                    buf_ptr = parse_index(type == MLOG_COMP_PAGE_REORGANIZE, mtr_buf);
+                    buf_ptr = read_compressed(&len, reader);
                     if (!buf_ptr) goto done;
-                    break;
+                    if (!skip_buffer_n(reader, len)) goto done;
                 }
-                case MLOG_UNDO_INSERT: {
-                    uint16_t len;
-                    buf_ptr = read_buffer_n(&len, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "length: %"PRIu16"\n", len);
+                upd->fields.len = log_data_len(upd->fields.offset, B2F(mtr_buf));
+                break;
+            }
+            case MLOG_REC_SEC_DELETE_MARK:
+            case MLOG_COMP_REC_SEC_DELETE_MARK: {
+                uint8_t val;
+                if (type == MLOG_COMP_REC_SEC_DELETE_MARK
+                    && !parse_index(1, reader, mtr))
+                    goto done;
+                buf_ptr = read_buffer_n(&val, reader, 1);
+                if (!buf_ptr) goto done;
+                mtr->value = val;
+                if (!read_page_offset(reader, mtr)) goto done;
+                break;
+            }
+            case MLOG_REC_CLUST_DELETE_MARK:
+            case MLOG_COMP_REC_CLUST_DELETE_MARK: {
+                mtr_update_t* upd = &mtr->update;
+                if (!parse_index(type == MLOG_COMP_REC_CLUST_DELETE_MARK, reader, mtr))
+                    goto done;
 
-                    buf_ptr = read_buffer_n(NULL, mtr_buf, len);
-                    if (!buf_ptr) goto done;
-                    mtr_buf->buffer_offset += len;
-                    hexdump(buf_ptr, len);
-                    break;
-                }
-                case MLOG_REC_UPDATE_IN_PLACE:
-                case MLOG_COMP_REC_UPDATE_IN_PLACE: {
-                    buf_ptr = parse_index(type == MLOG_COMP_REC_UPDATE_IN_PLACE, mtr_buf);
-                    if (!buf_ptr) goto done;
-                    uint8_t flags;
-                    buf_ptr = read_buffer_n(&flags, mtr_buf, 1);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "flags: %"PRIu8"\n", flags);
+                buf_ptr = read_buffer_n(&upd->flags, reader, 1);
+                if (!buf_ptr) goto done;
+                buf_ptr = read_buffer_n(&upd->val, reader, 1);
+                if (!buf_ptr) goto done;
+                if (!parse_trx_id(reader, upd)) goto done;
+                if (!read_page_offset(reader, mtr)) goto done;
+                break;
+            }
+            case MLOG_WRITE_STRING: {
+                uint16_t len;
+                if (!read_page_offset(reader, mtr)) goto done;
+                buf_ptr = read_buffer_n(&len, reader, 2);
+                if (!buf_ptr) goto done;
+                if (!read_view(&mtr->data, reader, len)) goto done;
+                break;
+            }
+            case MLOG_UNDO_INIT: {
+                uint32_t seg_type;
+                buf_ptr = read_compressed(&seg_type, reader);
+                if (!buf_ptr) goto done;
+                mtr->value = seg_type;
+                break;
+            }
+            case MLOG_UNDO_HDR_CREATE:
+            case MLOG_UNDO_HDR_REUSE: {
+                buf_ptr = read_compressed_64(&mtr->value, reader);
+                if (!buf_ptr) goto done;
+                break;
+            }
+            case MLOG_FILE_CREATE2: {
+                uint32_t flags;
+                buf_ptr = read_buffer_n(&flags, reader, 4);
+                if (!buf_ptr) goto done;
+                mtr->value = flags;
+            }
+            /* fall through */
+            case MLOG_FILE_RENAME:
+            case MLOG_FILE_RENAME2:
+            case MLOG_FILE_CREATE:
+            case MLOG_FILE_DELETE:
+            case MLOG_FILE_NAME: {
+                uint16_t name_len;
+                buf_ptr = read_buffer_n(&name_len, reader, 2);
+                if (!buf_ptr) goto done;
+                if (!read_view(&mtr->data, reader, name_len)) goto done;
+                if (type != MLOG_FILE_RENAME && type != MLOG_FILE_RENAME2) break;
 
-                    uint32_t pos;
-                    buf_ptr = read_compressed(&pos, mtr_buf);
-                    if (!buf_ptr) goto done;
+                buf_ptr = read_buffer_n(&name_len, reader, 2);
+                if (!buf_ptr) goto done;
+                if (!read_view(&mtr->data2, reader, name_len)) goto done;
+                break;
+            }
+            case MLOG_REC_MIN_MARK:
+            case MLOG_COMP_REC_MIN_MARK: {
+                if (!read_page_offset(reader, mtr)) goto done;
+                break;
+            }
+            case MLOG_ZIP_WRITE_NODE_PTR:
+            case MLOG_ZIP_WRITE_BLOB_PTR: {
+                uint16_t z_offset;
+                if (!read_page_offset(reader, mtr)) goto done;
+                buf_ptr = read_buffer_n(&z_offset, reader, 2);
+                if (!buf_ptr) goto done;
+                mtr->value = z_offset;
+                if (!read_view(&mtr->data, reader, type == MLOG_ZIP_WRITE_NODE_PTR
+                            ? REC_NODE_PTR_SIZE : BTR_EXTERN_FIELD_REF_SIZE))
+                    goto done;
+                break;
+            }
+            case MLOG_ZIP_WRITE_HEADER: {
+                uint8_t offset, len;
+                buf_ptr = read_buffer_n(&offset, reader, 1);
+                if (!buf_ptr) goto done;
+                mtr->page_offset = offset;
+                buf_ptr = read_buffer_n(&len, reader, 1);
+                if (!buf_ptr) goto done;
+                if (!read_view(&mtr->data, reader, len)) goto done;
+                break;
+            }
+            case MLOG_ZIP_PAGE_COMPRESS: {
+                /* FIL_PAGE_PREV and FIL_PAGE_NEXT, the compressed page
+                 * and its trailer */
+                uint16_t size, trailer_size;
+                buf_ptr = read_buffer_n(&size, reader, 2);
+                if (!buf_ptr) goto done;
+                buf_ptr = read_buffer_n(&trailer_size, reader, 2);
+                if (!buf_ptr) goto done;
+                mtr->value = trailer_size;
+                if (!read_view(&mtr->data, reader, 8 + size + trailer_size)) goto done;
+                break;
+            }
+            case MLOG_ZIP_PAGE_COMPRESS_NO_DATA:
+            case MLOG_ZIP_PAGE_REORGANIZE: {
+                uint8_t level;
+                if (!parse_index(1, reader, mtr)) goto done;
+                buf_ptr = read_buffer_n(&level, reader, 1);
+                if (!buf_ptr) goto done;
+                mtr->value = level;
+                break;
+            }
+            case MLOG_CHECKPOINT: {
+                buf_ptr = read_buffer_n(&mtr->value, reader, 8);
+                if (!buf_ptr) goto done;
+                break;
+            }
+            case MLOG_UNDO_ERASE_END:
+            case MLOG_UNDO_HDR_DISCARD:
+            case MLOG_LSN:
+            case MLOG_INIT_FILE_PAGE:
+            case MLOG_IBUF_BITMAP_INIT:
+            case MLOG_PAGE_CREATE:
+            case MLOG_COMP_PAGE_CREATE:
+            case MLOG_PAGE_CREATE_RTREE:
+            case MLOG_COMP_PAGE_CREATE_RTREE:
+            case MLOG_DUMMY_RECORD:
+            case MLOG_MULTI_REC_END: break;
+            default: {
+                /* not a record type: the log is corrupt here, go on at
+                 * the next record group */
+                block_hdr block_header;
+                off_t offset;
+                print_log(reader, 0, "[WARNING] unknown mtr type %"PRIu8" at offset "
+                        "%lld, skipping to the next record group\n",
+                        type, (long long)mtr->offset);
+                offset = find_resync_block(reader, rec_offset + 1, &block_header);
+                if (offset == -1) goto done;
+                if (reader->short_block != -1 && offset > reader->short_block)
+                    goto done;
+                reader_seek(reader, offset + block_header.first_rec_group);
+                ++reader->resyncs;
+                continue;
+            }
+        }
+        if (!passes) {
+            ++reader->filtered;
+            continue;
+        }
+        if (mtr->lsn < reader->opt.from_lsn) continue;
+        /* end of mtr: the body is still in the buffer unless a refill had to
+         * drop it, then it is left in the file, see payload_cursor_t */
+        ++reader->records;
+        ++reader->type_records[type];
+        mtr->len = log_data_len(rec_offset, B2F(mtr_buf));
+        mtr->payload.offset = body_offset;
+        if (mtr_buf->mark >= 0) {
+            mtr->payload.data = mtr_buf->buffer + mtr_buf->mark;
+            mtr->payload.len = mtr_buf->buffer_offset - mtr_buf->mark;
+        } else {
+            mtr->payload.data = NULL;
+            mtr->payload.len = log_data_len(body_offset, B2F(mtr_buf));
+        }
+        resolve_view(&mtr->index.fields, &mtr->payload);
+        resolve_view(&mtr->insert.end_seg, &mtr->payload);
+        resolve_view(&mtr->update.fields, &mtr->payload);
+        resolve_view(&mtr->data, &mtr->payload);
+        resolve_view(&mtr->data2, &mtr->payload);
+        if (!reader->by_mtr) PROF_LEAVE(reader);
+        return 1;
+    }
+done:
+    if (!reader->by_mtr) PROF_LEAVE(reader);
+    return 0;
+}
 
-                    uint64_t roll_ptr, trx_id;
-                    buf_ptr = read_buffer_n(&roll_ptr, mtr_buf, DATA_ROLL_PTR_LEN);
-                    if (!buf_ptr) goto done;
-                    buf_ptr = read_compressed_64(&trx_id, mtr_buf);
-                    if (!buf_ptr) goto done;
+/* point the payload of a record at a copy and resolve its views again */
+static void move_payload(s_mtr_t* mtr, const byte* data) {
+    mtr->payload.data = data;
+    resolve_view(&mtr->index.fields, &mtr->payload);
+    resolve_view(&mtr->insert.end_seg, &mtr->payload);
+    resolve_view(&mtr->update.fields, &mtr->payload);
+    resolve_view(&mtr->data, &mtr->payload);
+    resolve_view(&mtr->data2, &mtr->payload);
+}
 
-                    print_log(0, "TRX_ID position in record: %"PRIx32", roll ptr: 0x%"PRIx64"\n"
-                           "TRX_ID: 0x%016"PRIx64"\n",
-                           pos, roll_ptr, trx_id);
+/* decode the records of the next mini-transaction into group, as
+ * recv_parse_log_recs groups them; an mtr cut off by the end of the log
+ * is dropped. With filters, the group has the records that pass and an
+ * mtr without any is skipped. Returns 1 on an mtr, 0 at the end */
+int reader_next_mtr(reader_t* reader, mtr_group_t* group) {
+    out_buf_t* payloads = &group->payloads;
+    const byte* old_data;
+    s_mtr_t* mtr;
+    byte type;
+    size_t i, pos;
+    uint64_t resyncs = reader->resyncs;
+    off_t resume = 0;
+
+    group->n = 0;
+    payloads->len = 0;
+    reader->by_mtr = 1;
+    PROF_ENTER(reader);
+    while (1) {
+        if (group->n == group->size) {
+            group->size = group->size ? group->size * 2 : 64;
+            group->recs = realloc(group->recs, group->size * sizeof(*group->recs));
+            if (!group->recs) {
+                perror("realloc");
+                exit(2);
+            }
+        }
+        mtr = &group->recs[group->n];
+        if (reader_next_record(reader, mtr) <= 0) {
+            /* the log ends inside the mtr */
+            if (group->n) reader->resume_offset = resume;
+            PROF_LEAVE(reader);
+            return 0;
+        }
+        /* the reader skipped garbage: the records so far are of an mtr
+         * whose end is lost */
+        if (reader->resyncs != resyncs) {
+            resyncs = reader->resyncs;
+            group->recs[0] = *mtr;
+            mtr = group->recs;
+            group->n = 0;
+            payloads->len = 0;
+        }
 
-                    uint16_t page_offset;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "page offset: %"PRIu16"\n", page_offset);
+        /* copy the payload out of the read buffer (or the file); the copies
+         * are laid end to end, so they are easy to follow if the pool moves */
+        old_data = payloads->data;
+        out_reserve(payloads, mtr->payload.len);
+        if (payloads->data != old_data)
+            for (i=0, pos=0; i<group->n; pos += group->recs[i++].payload.len)
+                move_payload(&group->recs[i], payloads->data + pos);
+        if (mtr->payload.len
+            && !copy_view(reader, &mtr->payload, payloads->data + payloads->len))
+            memset(payloads->data + payloads->len, 0, mtr->payload.len);
+        move_payload(mtr, payloads->data + payloads->len);
+        payloads->len += mtr->payload.len;
+
+        if (group->n++ == 0) {
+            resume = reader->resume_offset;
+            group->start_lsn = mtr->lsn;
+            group->bytes = 0;
+        }
+        group->bytes += mtr->len;
+        type = mtr->type & (byte)~MLOG_SINGLE_REC_FLAG;
+        if (group->n == 1 && type == MLOG_MULTI_REC_END
+            && (reader->opt.filter_space || reader->opt.filter_page
+                || reader->opt.filter_type)) {
+            group->n = 0;
+            payloads->len = 0;
+            continue;
+        }
+        if ((group->n == 1 && mtr_is_single_rec(mtr)) || type == MLOG_MULTI_REC_END) {
+            group->end_lsn = lsn_add_data(mtr->lsn, mtr->len);
+            PROF_LEAVE(reader);
+            return 1;
+        }
+    }
+}
 
-                    uint8_t info_bits;
-                    buf_ptr = read_buffer_n(&info_bits, mtr_buf, 1);
-                    if (!buf_ptr) goto done;
+void free_mtr_group(mtr_group_t* group) {
+    free(group->recs);
+    free(group->payloads.data);
+    memset(group, 0, sizeof(*group));
+}
 
-                    uint32_t n_fields;
-                    buf_ptr = read_compressed(&n_fields, mtr_buf);
-                    if (!buf_ptr) goto done;
+/* first block at or after offset in which a record group starts */
+off_t find_resync_block(reader_t* reader, off_t offset, block_hdr* block_header) {
+    byte block_buffer[OS_FILE_LOG_BLOCK_SIZE];
+    const byte* block;
+    offset += (OS_FILE_LOG_BLOCK_SIZE - offset % OS_FILE_LOG_BLOCK_SIZE)
+        % OS_FILE_LOG_BLOCK_SIZE;
+    while ((block = read_log_block(reader, offset, block_buffer))) {
+        parse_block_header(block, block_header);
+        if (!block_in_sequence(reader, offset, block_header)) break;
+        if (block_header->first_rec_group >= LOG_BLOCK_HDR_SIZE
+            && block_header->first_rec_group < block_header->block_data_len)
+            return offset;
+        offset += OS_FILE_LOG_BLOCK_SIZE;
+    }
+    return -1;
+}
 
-                    print_log(0, "info_bits: %"PRIu8", n_fields: %"PRIu32"\n",
-                            info_bits, n_fields);
-                    uint32_t i, field_no, len, delta;
-                    for (i=0; i<n_fields; ++i) {
-                        buf_ptr = read_compressed(&field_no, mtr_buf);
-                        if (!buf_ptr) goto done;
-                        buf_ptr = read_compressed(&len, mtr_buf);
-                        if (!buf_ptr) goto done;
-                        print_log(0, "field_no: %"PRIu32", len: %"PRIu32"\n", field_no, len);
-                        while (len > 0) {
-                            buf_ptr = read_buffer_n(NULL, mtr_buf, len);
-                            if (!buf_ptr) goto done;
-                            delta = mtr_buf->buffer_len < len ?
-                                    mtr_buf->buffer_len : len;
-                            mtr_buf->buffer_offset += delta;
-
-                            assert(delta > 0);
-                            hexdump(buf_ptr, delta);
-                            len -= delta;
-                        }
-                    }
-
-                    break;
-                }
-                case MLOG_REC_DELETE:
-                case MLOG_COMP_REC_DELETE: {
-                    buf_ptr = parse_index(type == MLOG_COMP_REC_DELETE, mtr_buf);
-                    if (!buf_ptr) goto done;
 
-                    uint16_t page_offset;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "page offset: %"PRIu16"\n", page_offset);
-                    break;
-                }
-                case MLOG_REC_SEC_DELETE_MARK: {
-                    uint8_t val;
-                    buf_ptr = read_buffer_n(&val, mtr_buf, 1);
-                    if (!buf_ptr) goto done;
+int find_block_header(reader_t* reader, off_t offset, block_hdr* block_header) {
+    byte block_buffer[OS_FILE_LOG_BLOCK_SIZE];
+    const byte* block = read_log_block(reader, offset, block_buffer);
+    if (!block) return 0;
+    parse_block_header(block, block_header);
+    return 1;
+}
 
-                    uint16_t page_offset;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
+static uint32_t crc32c_table[256];
+#if defined(__x86_64__)
+static int crc32c_hw;       /* the SSE4.2 crc32 instruction is there */
+#endif
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init(void) {
+    uint32_t crc;
+    int i, j;
+    for (i=0; i<256; ++i) {
+        crc = i;
+        for (j=0; j<8; ++j) crc = crc >> 1 ^ (0x82F63B78 & -(crc & 1));
+        crc32c_table[i] = crc;
+    }
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    crc32c_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
 
-                    print_log(0, "val: %"PRIu8", page offset: %"PRIu16"\n", val, page_offset);
-                    break;
-                }
-                case MLOG_REC_CLUST_DELETE_MARK:
-                case MLOG_COMP_REC_CLUST_DELETE_MARK: {
-                    buf_ptr = parse_index(type == MLOG_COMP_REC_CLUST_DELETE_MARK, mtr_buf);
-                    if (!buf_ptr) goto done;
-                    uint8_t flags, val;
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(const byte* buf, size_t len) {
+    uint64_t crc = 0xFFFFFFFF, word;
+    for (; len >= 8; len -= 8, buf += 8) {
+        memcpy(&word, buf, 8);
+        crc = __builtin_ia32_crc32di(crc, word);
+    }
+    while (len--) crc = __builtin_ia32_crc32qi(crc, *buf++);
+    return ~(uint32_t)crc;
+}
 
-                    buf_ptr = read_buffer_n(&flags, mtr_buf, 1);
-                    if (!buf_ptr) goto done;
+/* three blocks at once: each crc32 waits for the one before it, so three
+ * independent chains keep the unit busy */
+__attribute__((target("sse4.2")))
+static void crc32c_sse42_x3(const byte* a, const byte* b, const byte* c,
+        size_t len, uint32_t* crcs) {
+    uint64_t ca = 0xFFFFFFFF, cb = 0xFFFFFFFF, cc = 0xFFFFFFFF, wa, wb, wc;
+    size_t i;
+    for (i=0; i + 8 <= len; i += 8) {
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        memcpy(&wc, c + i, 8);
+        ca = __builtin_ia32_crc32di(ca, wa);
+        cb = __builtin_ia32_crc32di(cb, wb);
+        cc = __builtin_ia32_crc32di(cc, wc);
+    }
+    for (; i<len; ++i) {
+        ca = __builtin_ia32_crc32qi(ca, a[i]);
+        cb = __builtin_ia32_crc32qi(cb, b[i]);
+        cc = __builtin_ia32_crc32qi(cc, c[i]);
+    }
+    crcs[0] = ~(uint32_t)ca;
+    crcs[1] = ~(uint32_t)cb;
+    crcs[2] = ~(uint32_t)cc;
+}
+#endif
 
-                    buf_ptr = read_buffer_n(&val, mtr_buf, 1);
-                    if (!buf_ptr) goto done;
+/* ut_crc32: CRC-32C, with SSE4.2 when the CPU has it */
+uint32_t crc32c(const byte* buf, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    pthread_once(&crc32c_once, crc32c_init);
+#if defined(__x86_64__)
+    if (crc32c_hw) return crc32c_sse42(buf, len);
+#endif
+    while (len--) crc = crc >> 8 ^ crc32c_table[(crc ^ *buf++) & 0xFF];
+    return ~crc;
+}
 
-                    print_log(0, "flags: %"PRIu8", val: %"PRIu8"\n", flags, val);
+/* log_block_calc_checksum_innodb */
+uint32_t log_block_checksum_innodb(const byte* block) {
+    uint64_t sum = 1, b;
+    int i, sh = 0;
+    for (i=0; i<OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE; ++i) {
+        b = block[i];
+        sum &= 0x7FFFFFFFUL;
+        sum += b;
+        sum += b << sh;
+        if (++sh > 24) sh = 0;
+    }
+    return (uint32_t)sum;
+}
 
-                    uint32_t pos;
-                    buf_ptr = read_compressed(&pos, mtr_buf);
-                    if (!buf_ptr) goto done;
+/* log_block_checksum_is_ok_or_old_format, with crc the CRC-32C of the
+ * block if it is known already */
+static int checksum_matches(const reader_t* reader, const byte* block,
+        int64_t crc) {
+    uint32_t checksum = mach_read_4(block + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_CHECKSUM);
+    int algorithm = reader->opt.checksum;
+    block_hdr block_header;
 
-                    uint64_t roll_ptr, trx_id;
-                    buf_ptr = read_buffer_n(&roll_ptr, mtr_buf, DATA_ROLL_PTR_LEN);
-                    if (!buf_ptr) goto done;
-                    buf_ptr = read_compressed_64(&trx_id, mtr_buf);
-                    if (!buf_ptr) goto done;
+    /* the old format: log_block_get_hdr_no, without the flush bit */
+    parse_block_header(block, &block_header);
+    if (checksum == block_header.block_no) return 1;
+    if (algorithm == CHECKSUM_ANY && checksum == LOG_NO_CHECKSUM_MAGIC) return 1;
+    if (algorithm != CHECKSUM_INNODB) {
+        if (crc < 0)
+            crc = crc32c(block, OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE);
+        if (checksum == crc) return 1;
+    }
+    return algorithm != CHECKSUM_CRC32
+        && checksum == log_block_checksum_innodb(block);
+}
 
-                    print_log(0, "TRX_ID position in record: %"PRIx32", roll ptr: 0x%"PRIx64"\n"
-                           "TRX_ID: 0x%016"PRIx64"\n",
-                           pos, roll_ptr, trx_id);
+int log_block_checksum_is_ok(const reader_t* reader, const byte* block) {
+    return checksum_matches(reader, block, -1);
+}
 
-                    uint16_t page_offset;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "page offset: %"PRIu16"\n", page_offset);
-                    break;
-                }
-                case MLOG_WRITE_STRING: {
-                    uint16_t page_offset, len;
-                    buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
-                    buf_ptr = read_buffer_n(&len, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "page offset: %"PRIu16", len: %"PRIu16"\n",
-                            page_offset, len);
+static void verify_block(const byte* block, int file, off_t offset, int ok,
+        verify_stat* stat) {
+    uint32_t block_no = mach_read_4(block + LOG_BLOCK_HDR_NO);
+    ++stat->blocks;
+    if (block_no == 0
+        && mach_read_4(block + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_CHECKSUM) == 0) {
+        ++stat->empty;
+        return;
+    }
+    if (ok) return;
+    if (!stat->bad || offset < stat->first_bad_offset) {
+        stat->first_bad_file = file;
+        stat->first_bad_offset = offset;
+        stat->first_bad_no = block_no & ~LOG_BLOCK_FLUSH_BIT_MASK;
+    }
+    ++stat->bad;
+}
 
-                    buf_ptr = read_buffer_n(NULL, mtr_buf, len);
-                    if (!buf_ptr) goto done;
-                    mtr_buf->buffer_offset += len;
-                    hexdump(buf_ptr, len);
-                    break;
-                }
-                case MLOG_UNDO_INIT: {
-                    uint32_t seg_type;
-                    buf_ptr = read_compressed(&seg_type, mtr_buf);
-                    if (!buf_ptr) goto done;
-                    print_log(0, "undo log segment type: %"PRIu32"\n", seg_type);
-                    break;
-                }
-                case MLOG_UNDO_HDR_CREATE:
-                case MLOG_UNDO_HDR_REUSE: {
-                    uint64_t trx_id;
-                    buf_ptr = read_compressed_64(&trx_id, mtr_buf);
-                    print_log(0, "TRX_ID: %"PRIu64"\n", trx_id);
-                    break;
-                }
-                case MLOG_FILE_CREATE:
-                case MLOG_FILE_DELETE: {
-                    uint16_t name_len;
-                    buf_ptr = read_buffer_n(&name_len, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
+/* check the checksums of the blocks between two offsets of one file of
+ * the reader, header blocks excluded. Only reads through the reader, so
+ * threads may verify different ranges of the same reader */
+void verify_blocks(const reader_t* reader, int file, off_t from, off_t to,
+        verify_stat* stat) {
+    ssize_t chunk_size = reader->opt.buffer_size, ret, i;
+    byte* chunk = NULL;
+    const byte* blocks;
+
+    if (from < LOG_FILE_HDR_SIZE) from = LOG_FILE_HDR_SIZE;
+    if (to > reader->log_size) to = reader->log_size;
+    if (!reader->maps[file]) {
+        chunk = malloc(chunk_size);
+        if (!chunk) {
+            perror("malloc");
+            exit(2);
+        }
+    }
+    pthread_once(&crc32c_once, crc32c_init);
+
+    while (from < to) {
+        if (chunk) {
+            if (chunk_size > to - from) chunk_size = to - from;
+            ret = pread(reader->fds[file], chunk, chunk_size, from);
+            ++stat->syscalls;
+            if (ret < OS_FILE_LOG_BLOCK_SIZE) break;
+            blocks = chunk;
+        } else {
+            ret = to - from;
+            blocks = reader->maps[file] + from;
+        }
+        ret -= ret % OS_FILE_LOG_BLOCK_SIZE;
+
+        for (i=0; i<ret; i+=OS_FILE_LOG_BLOCK_SIZE) {
+            const byte* block = blocks + i;
+#if defined(__x86_64__)
+            if (crc32c_hw && reader->opt.checksum != CHECKSUM_INNODB
+                && i + 3 * OS_FILE_LOG_BLOCK_SIZE <= ret) {
+                uint32_t crcs[3];
+                int j;
+                crc32c_sse42_x3(block, block + OS_FILE_LOG_BLOCK_SIZE,
+                        block + 2 * OS_FILE_LOG_BLOCK_SIZE,
+                        OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE, crcs);
+                for (j=0; j<3; ++j)
+                    verify_block(block + j * OS_FILE_LOG_BLOCK_SIZE, file,
+                            from + i + j * OS_FILE_LOG_BLOCK_SIZE,
+                            checksum_matches(reader,
+                                block + j * OS_FILE_LOG_BLOCK_SIZE, crcs[j]),
+                            stat);
+                i += 2 * OS_FILE_LOG_BLOCK_SIZE;
+                continue;
+            }
+#endif
+            verify_block(block, file, from + i,
+                    checksum_matches(reader, block, -1), stat);
+        }
+        from += ret;
+    }
+    free(chunk);
+}
 
-                    buf_ptr = read_buffer_n(NULL, mtr_buf, name_len);
-                    if (!buf_ptr) goto done;
-                    mtr_buf->buffer_offset += name_len;
-                    print_log(0, "filename: %s\n", buf_ptr);
-                    break;
-                }
-                case MLOG_FILE_RENAME: {
-                    uint16_t name_len;
-                    buf_ptr = read_buffer_n(&name_len, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
+/* add the first record group of a block to the index, at most one every
+ * interval blocks */
+void index_block(reader_t* reader, off_t offset, const block_hdr* block_header) {
+    block_index_t* index = reader->index;
+    index_entry_t* entry;
+
+    if (offset < index->next_offset
+        || block_header->first_rec_group < LOG_BLOCK_HDR_SIZE
+        || block_header->first_rec_group >= block_header->block_data_len)
+        return;
+    if (index->n == index->size) {
+        index->size = index->size ? index->size * 2 : 1024;
+        index->entries = realloc(index->entries, index->size * sizeof(*entry));
+        if (!index->entries) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    entry = &index->entries[index->n++];
+    entry->lsn = block_no_to_lsn(reader, block_header->block_no)
+        + block_header->first_rec_group;
+    entry->offset = offset + block_header->first_rec_group;
+    entry->block_no = block_header->block_no;
+    entry->check_point_no = block_header->check_point_no;
+    entry->first_rec_group = block_header->first_rec_group;
+    index->next_offset = offset + (off_t)index->interval * OS_FILE_LOG_BLOCK_SIZE;
+}
 
-                    buf_ptr = read_buffer_n(NULL, mtr_buf, name_len);
-                    if (!buf_ptr) goto done;
-                    mtr_buf->buffer_offset += name_len;
-                    print_log(0, "old filename: %s\n", buf_ptr);
+/* the last entry at or before lsn, NULL if there is none */
+const index_entry_t* find_index_entry(const block_index_t* index, uint64_t lsn) {
+    size_t low = 0, high = index->n;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->entries[mid].lsn <= lsn) low = mid + 1;
+        else high = mid;
+    }
+    return low ? &index->entries[low - 1] : NULL;
+}
 
-                    buf_ptr = read_buffer_n(&name_len, mtr_buf, 2);
-                    if (!buf_ptr) goto done;
+/* move the reader to the record group of an index entry */
+void reader_seek_index(reader_t* reader, const index_entry_t* entry) {
+    reader->start_lsn = entry->lsn;
+    reader->start_offset = entry->offset;
+    reader_seek(reader, entry->offset);
+}
 
-                    buf_ptr = read_buffer_n(NULL, mtr_buf, name_len);
-                    if (!buf_ptr) goto done;
-                    mtr_buf->buffer_offset += name_len;
-                    print_log(0, "new filename: %s\n", buf_ptr);
+int write_index(const block_index_t* index, const char* path) {
+    byte entry_buf[INDEX_ENTRY_SIZE], *ptr;
+    FILE* file = fopen(path, "wb");
+    size_t i;
+    if (!file) {
+        perror("fopen");
+        return 0;
+    }
+    ptr = write_be(entry_buf, INDEX_MAGIC, 4);
+    ptr = write_be(ptr, index->interval, 4);
+    fwrite(entry_buf, 1, INDEX_HDR_SIZE, file);
+    for (i=0; i<index->n; ++i) {
+        const index_entry_t* entry = &index->entries[i];
+        ptr = write_be(entry_buf, entry->lsn, 8);
+        ptr = write_be(ptr, entry->offset, 8);
+        ptr = write_be(ptr, entry->block_no, 4);
+        ptr = write_be(ptr, entry->check_point_no, 4);
+        ptr = write_be(ptr, entry->first_rec_group, 2);
+        fwrite(entry_buf, 1, INDEX_ENTRY_SIZE, file);
+    }
+    if (fclose(file) == EOF) {
+        perror("fclose");
+        return 0;
+    }
+    return 1;
+}
 
-                    break;
-                }
-                case MLOG_INIT_FILE_PAGE:
-                case MLOG_IBUF_BITMAP_INIT:
-                case MLOG_PAGE_CREATE:
-                case MLOG_COMP_PAGE_CREATE:
-                case MLOG_MULTI_REC_END: break;
-                default:
-                   print_log(0, "[WARNING] This MTR cannot be parsed (not yet implemented). "
-                          "mtr type number: %"PRIu8", "
-                          "buffer_offset %"PRIu64", "
-                          "buffer_length %lu\n",
-                          type, mtr_buf->buffer_offset, mtr_buf->buffer_len);
-                   flag = 0;
-                   break;
+/* 0 on a missing or malformed index file */
+int read_index(block_index_t* index, const char* path) {
+    byte entry_buf[INDEX_ENTRY_SIZE];
+    FILE* file = fopen(path, "rb");
+    index_entry_t entry;
+    if (!file) {
+        perror("fopen");
+        return 0;
+    }
+    memset(index, 0, sizeof(*index));
+    if (fread(entry_buf, 1, INDEX_HDR_SIZE, file) != INDEX_HDR_SIZE
+        || mach_read_4(entry_buf) != INDEX_MAGIC) {
+        fprintf(stderr, "%s: not an index file\n", path);
+        fclose(file);
+        return 0;
+    }
+    index->interval = mach_read_4(entry_buf + 4);
+    while (fread(entry_buf, 1, INDEX_ENTRY_SIZE, file) == INDEX_ENTRY_SIZE) {
+        entry.lsn = mach_read_8(entry_buf);
+        entry.offset = mach_read_8(entry_buf + 8);
+        entry.block_no = mach_read_4(entry_buf + 16);
+        entry.check_point_no = mach_read_4(entry_buf + 20);
+        entry.first_rec_group = mach_read_2(entry_buf + 24);
+        if (index->n == index->size) {
+            index->size = index->size ? index->size * 2 : 1024;
+            index->entries = realloc(index->entries,
+                    index->size * sizeof(entry));
+            if (!index->entries) {
+                perror("realloc");
+                exit(2);
             }
-            /* end of mtr */
         }
+        index->entries[index->n++] = entry;
     }
-done:
-    log_indent = 0;
-    print_log(0, "done");
-    return 0;
+    fclose(file);
+    return 1;
+}
+
+void free_index(block_index_t* index) {
+    free(index->entries);
+    memset(index, 0, sizeof(*index));
+}
+
+/* the file holding the block at offset (an LSN in group mode), the offset
+ * of the block in that file and the bytes from there to the end of the
+ * file */
+int locate_block(const reader_t* reader, off_t offset, off_t* pos, off_t* left) {
+    int file = 0;
+    if (reader->group) {
+        offset = group_offset(reader, offset);
+        file = offset / reader->log_size;
+        offset %= reader->log_size;
+    }
+    *pos = offset;
+    *left = reader->log_size - offset;
+    return file;
+}
+
+/* log_group_calc_lsn_offset: offset of an LSN in the group, with the files
+ * (headers included) laid end to end, from the position of the checkpoint */
+off_t group_offset(const reader_t* reader, uint64_t lsn) {
+    off_t data_size = reader->log_size - LOG_FILE_HDR_SIZE;
+    uint64_t capacity = (uint64_t)data_size * reader->n_files;
+    off_t cp_offset = reader->checkpoint.offset;
+    uint64_t offset, difference;
+
+    /* log_group_calc_size_offset: without the file headers */
+    offset = cp_offset - LOG_FILE_HDR_SIZE * (1 + cp_offset / reader->log_size);
+    if (lsn >= reader->checkpoint.lsn) {
+        difference = lsn - reader->checkpoint.lsn;
+    } else {
+        difference = capacity - (reader->checkpoint.lsn - lsn) % capacity;
+    }
+    offset = (offset + difference) % capacity;
+    /* log_group_calc_real_offset */
+    return offset + LOG_FILE_HDR_SIZE * (1 + offset / data_size);
+}
+
+/* in group mode, a block that does not carry the number for its LSN was
+ * left by the previous round of the circular log */
+int block_in_sequence(const reader_t* reader, off_t offset,
+        const block_hdr* block_header) {
+    return !reader->group || block_header->block_no
+        == (((uint64_t)offset / OS_FILE_LOG_BLOCK_SIZE) & 0x3FFFFFFFUL) + 1;
+}
+
+/* 0 for a block past the end of the log; with opt.stop_at_short_block the
+ * log ends at the first block that is not full, whatever follows it, and
+ * with opt.stop_at_bad_block at a block with a bad checksum */
+int block_in_log(reader_t* reader, off_t offset, const byte* block,
+        const block_hdr* block_header) {
+    if (block_header->block_data_len == 0) return 0;
+    if (!block_in_sequence(reader, offset, block_header)) return 0;
+    if (reader->opt.stop_at_bad_block && !log_block_checksum_is_ok(reader, block))
+        return 0;
+    if (!reader->opt.stop_at_short_block) return 1;
+    if (reader->short_block != -1 && offset > reader->short_block) return 0;
+    if (block_header->block_data_len < OS_FILE_LOG_BLOCK_SIZE)
+        reader->short_block = offset;
+    return 1;
+}
+
+/* mmap mode: the block at offset, NULL past the end of the file */
+const byte* map_block(const reader_t* reader, off_t offset) {
+    off_t pos, left;
+    int file = locate_block(reader, offset, &pos, &left);
+    if (left < OS_FILE_LOG_BLOCK_SIZE) return NULL;
+    return reader->maps[file] + pos;
+}
+
+/* the block at offset, from the mapping or read into block_buffer */
+const byte* read_log_block(reader_t* reader, off_t offset, byte* block_buffer) {
+    off_t pos, left;
+    int file;
+    if (reader->log_map) return map_block(reader, offset);
+
+    file = locate_block(reader, offset, &pos, &left);
+    ++reader->stats.syscalls;
+    if (pread(reader->fds[file], block_buffer, OS_FILE_LOG_BLOCK_SIZE, pos)
+            != OS_FILE_LOG_BLOCK_SIZE)
+        return NULL;
+    reader->stats.bytes += OS_FILE_LOG_BLOCK_SIZE;
+    return block_buffer;
+}
+
+/* LSN of the start of a block, counting block numbers (which wrap at 1G)
+ * forward from the start LSN of the log file, or of the checkpoint in
+ * group mode */
+uint64_t block_no_to_lsn(const reader_t* reader, uint32_t block_no) {
+    uint64_t start_lsn = reader->start_lsn;
+    uint64_t start = start_lsn - start_lsn % OS_FILE_LOG_BLOCK_SIZE;
+    uint32_t start_no = ((start_lsn / OS_FILE_LOG_BLOCK_SIZE)
+            & ~LOG_BLOCK_FLUSH_BIT_MASK) + 1;
+    return start + (uint64_t)((block_no - start_no) & ~LOG_BLOCK_FLUSH_BIT_MASK)
+        * OS_FILE_LOG_BLOCK_SIZE;
 }
 
 uint8_t mtr_is_single_rec(const s_mtr_t* mtr) {
@@ -367,10 +1067,10 @@ uint8_t mtr_is_single_rec(const s_mtr_t* mtr) {
 }
 
 const char* mtr_type_name(const s_mtr_t* mtr) {
-    byte type = mtr->type;
-    if (mtr_is_single_rec(mtr)) {
-        type &= (byte)~MLOG_SINGLE_REC_FLAG;
-    }
+    return log_type_name(mtr->type & (byte)~MLOG_SINGLE_REC_FLAG);
+}
+
+const char* log_type_name(byte type) {
     switch (type) {
         case MLOG_1BYTE:
             return "MLOG_1BYTE";
@@ -468,145 +1168,582 @@ const char* mtr_type_name(const s_mtr_t* mtr) {
             return "MLOG_ZIP_PAGE_COMPRESS_NO_DATA";
         case MLOG_ZIP_PAGE_REORGANIZE:
             return "MLOG_ZIP_PAGE_REORGANIZE";
+        case MLOG_FILE_RENAME2:
+            return "MLOG_FILE_RENAME2";
+        case MLOG_FILE_NAME:
+            return "MLOG_FILE_NAME";
+        case MLOG_CHECKPOINT:
+            return "MLOG_CHECKPOINT";
+        case MLOG_PAGE_CREATE_RTREE:
+            return "MLOG_PAGE_CREATE_RTREE";
+        case MLOG_COMP_PAGE_CREATE_RTREE:
+            return "MLOG_COMP_PAGE_CREATE_RTREE";
         default:
             return "UNKNOW";
     }
 }
 
+/* the type specific fields are only set for the types that have them, so
+ * only the views are reset */
 void clear_mtr(s_mtr_t *mtr) {
     mtr->type = mtr->space_id = mtr->page_no = 0;
+    mtr->page_offset = -1;
+    mtr->lsn = mtr->offset = 0;
+    mtr->value = 0;
+    mtr->index.fields.len = mtr->insert.end_seg.len = 0;
+    mtr->update.fields.len = mtr->data.len = mtr->data2.len = 0;
 }
 
-byte* read_buffer_n(void* dst, buf_t* mtr_buf, const ssize_t n) {
-    assert(!dst || (dst && n <= 9));
-    if (mtr_buf->buffer_offset + n > mtr_buf->buffer_len) {
-        ssize_t remain = mtr_buf->buffer_len - mtr_buf->buffer_offset;
-        if (remain >= 0) {
-            memcpy(mtr_buf->buffer,
-                   mtr_buf->buffer + mtr_buf->buffer_offset,
-                   remain
-                  );
-
-            mtr_buf->buffer_offset = remain;
-            mtr_buf->start_buffer_offset = remain;
-            mtr_buf->start_file_offset = file_offset;
-            read_block_into_buffer(mtr_buf);
-            mtr_buf->buffer_offset = 0;
-        } else {
-            mtr_buf->buffer_offset = mtr_buf->buffer_len = 0;
-        }
+/* make n bytes available at buffer_offset: compact the unread tail to the
+ * front and load more blocks (or move the window in mmap mode) */
+void refill_buffer(reader_t* reader, const ssize_t n) {
+    buf_t* mtr_buf = &reader->buf;
+    off_t from = mtr_buf->buffer_offset, start_file_offset, start_buffer_offset;
+    uint64_t ticks = PROF_NOW(reader);
+    int at_group = mtr_buf->at_group;
+
+    ++reader->stats.refills;
+    if (reader->log_map) {
+        mtr_buf->mark = -1;
+        map_block_into_buffer(reader, n);
+        PROF_ADD(reader, PHASE_READ, ticks);
+        return;
     }
-    if (mtr_buf->buffer_len == 0) return NULL;
-
-    byte* val_ptr = mtr_buf->buffer + mtr_buf->buffer_offset;
-    if (dst) {
-        if (n == 1) {
-            READ_N(*(uint8_t*)dst, mtr_buf->buffer + mtr_buf->buffer_offset, n);
-        } else if (n == 2) {
-            READ_N(*(uint16_t*)dst, mtr_buf->buffer + mtr_buf->buffer_offset, n);
-        } else if (n > 2 && n <= 4) {
-            READ_N(*(uint32_t*)dst, mtr_buf->buffer + mtr_buf->buffer_offset, n);
-        } else {
-            READ_N(*(uint64_t*)dst, mtr_buf->buffer + mtr_buf->buffer_offset, n);
-        }
-        mtr_buf->buffer_offset += n;
+    if (from > mtr_buf->buffer_len) {
+        mtr_buf->buffer_offset = mtr_buf->buffer_len = 0;
+        return;
     }
+    /* keep the marked bytes too, unless they would take more than half of
+     * the buffer */
+    if (mtr_buf->mark >= 0
+        && mtr_buf->buffer_len - mtr_buf->mark <= mtr_buf->memory_size / 2)
+        from = mtr_buf->mark;
+    else
+        mtr_buf->mark = -1;
+
+    ssize_t remain = mtr_buf->buffer_len - from;
+    memmove(mtr_buf->buffer,
+           mtr_buf->buffer + from,
+           remain
+          );
+    reader->stats.compacted += remain;
+    PROF_ADD(reader, PHASE_COMPACT, ticks);
+    if (mtr_buf->mark >= 0) mtr_buf->mark -= from;
+
+    start_file_offset = mtr_buf->start_file_offset;
+    start_buffer_offset = mtr_buf->start_buffer_offset - from;
+    from = mtr_buf->buffer_offset - from;
+    mtr_buf->buffer_offset = remain;
+    mtr_buf->start_buffer_offset = remain;
+    mtr_buf->start_file_offset = reader->file_offset;
+    read_block_into_buffer(reader);
+    /* a buffer full of the tail of an mtr before the first record group */
+    while (mtr_buf->at_group && mtr_buf->buffer_len > 0) {
+        mtr_buf->buffer_offset = 0;
+        mtr_buf->start_file_offset = reader->file_offset;
+        read_block_into_buffer(reader);
+    }
+    PROF_ADD(reader, PHASE_READ, ticks);
+    /* else append_block put buffer_offset at the first record group */
+    if (!at_group) mtr_buf->buffer_offset = from;
+
+    /* nothing was read: the tail may end in a block that is not full, so
+     * it keeps the old mapping rather than one ending at file_offset */
+    if (mtr_buf->buffer_len == remain) {
+        mtr_buf->start_file_offset = start_file_offset;
+        mtr_buf->start_buffer_offset = start_buffer_offset;
+    }
+}
 
-    /* return pointer to the value */
-    return val_ptr;
+/* file offset past the last block a reader with an end_offset reads: a
+ * range ends where a record group starts, so none of its records runs
+ * past the block holding the byte before the end */
+static off_t range_read_end(const reader_t* reader) {
+    off_t last = reader->end_offset - 1;
+    return last - last % OS_FILE_LOG_BLOCK_SIZE + OS_FILE_LOG_BLOCK_SIZE;
 }
 
-void read_block_into_buffer(buf_t* mtr_buf) {
-    byte block_buffer[OS_FILE_LOG_BLOCK_SIZE];
-    block_hdr block_header;
+/* read as many whole blocks as fit into the free tail of the buffer with a
+ * single pread, then squeeze the headers and trailers out in place */
+void read_block_into_buffer(reader_t* reader) {
+    buf_t* mtr_buf = &reader->buf;
+    byte *chunk, *block;
+    off_t pos, left;
+    int file;
 
-    ssize_t ret, incr_len;
+    ssize_t ret, i, n_blocks;
     mtr_buf->buffer_len = mtr_buf->buffer_offset;
-    while (mtr_buf->buffer_len <= MEMORY_BUFFER_SIZE - OS_FILE_LOG_BLOCK_SIZE) {
-        ret = pread(fd, block_buffer,
-                OS_FILE_LOG_BLOCK_SIZE, file_offset);
-        if (ret != OS_FILE_LOG_BLOCK_SIZE) break;
-
-        file_offset += OS_FILE_LOG_BLOCK_SIZE;
-        parse_block_header(block_buffer, &block_header);
+    if (reader->opt.prefetch_depth > 0) {
+        if (!reader->prefetch) start_prefetch(reader);
+        while (mtr_buf->buffer_len <= mtr_buf->memory_size - OS_FILE_LOG_BLOCK_SIZE) {
+            if (reader->end_offset && reader->file_offset >= range_read_end(reader))
+                break;
+            block = prefetch_block(reader);
+            if (!block) break;
+            reader->file_offset += OS_FILE_LOG_BLOCK_SIZE;
+            if (!append_block(reader, block)) {
+                /* as below, and keep the block queued in the ring */
+                reader->file_offset -= OS_FILE_LOG_BLOCK_SIZE;
+                reader->prefetch->chunk_pos -= OS_FILE_LOG_BLOCK_SIZE;
+                break;
+            }
+        }
+        return;
+    }
 
-        if (block_header.block_data_len == 0) break;
-        if (mtr_buf->buffer_offset == 0 && block_header.first_rec_group != 0)
-            mtr_buf->buffer_offset = mtr_buf->buffer_len +
-                block_header.first_rec_group - LOG_BLOCK_HDR_SIZE;
+    /* nothing to read after the short block */
+    if (reader->short_block != -1 && reader->file_offset > reader->short_block)
+        return;
+    n_blocks = (mtr_buf->memory_size - mtr_buf->buffer_len) / OS_FILE_LOG_BLOCK_SIZE;
+    /* in group mode a read stops at the end of the current file */
+    file = locate_block(reader, reader->file_offset, &pos, &left);
+    if (reader->group && n_blocks > left / OS_FILE_LOG_BLOCK_SIZE)
+        n_blocks = left / OS_FILE_LOG_BLOCK_SIZE;
+    if (reader->end_offset && n_blocks >
+            (range_read_end(reader) - reader->file_offset) / OS_FILE_LOG_BLOCK_SIZE)
+        n_blocks = (range_read_end(reader) - reader->file_offset) / OS_FILE_LOG_BLOCK_SIZE;
+    if (n_blocks <= 0) return;
+
+    chunk = mtr_buf->memory + mtr_buf->buffer_len;
+    ret = pread(reader->fds[file], chunk, n_blocks * OS_FILE_LOG_BLOCK_SIZE, pos);
+    ++reader->stats.syscalls;
+    if (ret <= 0) return;
+    reader->stats.bytes += ret;
+    n_blocks = ret / OS_FILE_LOG_BLOCK_SIZE;
+    /* let the kernel fetch the next chunk while this one is parsed */
+    posix_fadvise(reader->fds[file], pos + ret, ret, POSIX_FADV_WILLNEED);
+
+    for (i=0; i<n_blocks; ++i) {
+        /* payloads only move towards the front: block i starts at or
+         * after the end of the payloads extracted so far */
+        block = chunk + i * OS_FILE_LOG_BLOCK_SIZE;
+        reader->file_offset += OS_FILE_LOG_BLOCK_SIZE;
+        if (!append_block(reader, block)) {
+            /* read it again next time, it may be written by then */
+            reader->file_offset -= OS_FILE_LOG_BLOCK_SIZE;
+            break;
+        }
+    }
+}
 
-        incr_len = block_header.block_data_len - LOG_BLOCK_HDR_SIZE;
-        if (block_header.block_data_len >= OS_FILE_LOG_BLOCK_SIZE)
-            incr_len -= LOG_BLOCK_TRL_SIZE;
-        memcpy(
-                mtr_buf->buffer + mtr_buf->buffer_len,
-                block_buffer + LOG_BLOCK_HDR_SIZE,
-                incr_len
-              );
-        mtr_buf->buffer_len += incr_len;
+/* append the payload of one block to the buffer, 0 on an empty block */
+int append_block(reader_t* reader, const byte* block) {
+    buf_t* mtr_buf = &reader->buf;
+    block_hdr block_header;
+    ssize_t incr_len;
+
+    parse_block_header(block, &block_header);
+    if (!block_in_log(reader, reader->file_offset - OS_FILE_LOG_BLOCK_SIZE, block,
+                &block_header))
+        return 0;
+    ++reader->stats.blocks;
+    if (reader->index)
+        index_block(reader, reader->file_offset - OS_FILE_LOG_BLOCK_SIZE, &block_header);
+    if (reader->file_offset - OS_FILE_LOG_BLOCK_SIZE == mtr_buf->start_file_offset)
+        mtr_buf->start_lsn = block_no_to_lsn(reader, block_header.block_no);
+
+    if (mtr_buf->at_group && block_header.first_rec_group != 0) {
+        mtr_buf->buffer_offset = mtr_buf->buffer_len +
+            block_header.first_rec_group - LOG_BLOCK_HDR_SIZE;
+        mtr_buf->at_group = 0;
     }
+
+    incr_len = block_header.block_data_len - LOG_BLOCK_HDR_SIZE;
+    if (block_header.block_data_len >= OS_FILE_LOG_BLOCK_SIZE)
+        incr_len -= LOG_BLOCK_TRL_SIZE;
+    memmove(
+            mtr_buf->memory + mtr_buf->buffer_len,
+            block + LOG_BLOCK_HDR_SIZE,
+            incr_len
+          );
+    mtr_buf->buffer_len += incr_len;
+    return 1;
 }
 
-byte* read_compressed(uint32_t* dst, buf_t* mtr_buf) {
-    byte* buf = read_buffer_n(NULL, mtr_buf, 5);
-    if (!buf) return NULL;
+/* started by the first read, so a reader that is moved with reader_seek
+ * first does not read ahead from the start of the file */
+void start_prefetch(reader_t* reader) {
+    int depth = reader->opt.prefetch_depth;
+    ssize_t chunk_size = reader->buf.memory_size;
+    prefetch_t* pf = calloc(1, sizeof(*pf));
+    if (pf) {
+        pf->cbs = calloc(depth, sizeof(*pf->cbs));
+        pf->memory = malloc(depth * chunk_size);
+    }
+    if (!pf || !pf->cbs || !pf->memory) {
+        perror("malloc");
+        exit(2);
+    }
+    pf->depth = depth;
+    pf->chunk_size = chunk_size;
+    reader->prefetch = pf;
+    seek_prefetch(reader, reader->file_offset);
+}
 
-    uint8_t flag = (uint8_t)(*buf & 0xFFUL);
-    if (flag < 0x80UL) {
-        mtr_buf->buffer_offset += 1;
-        *dst = *buf;
-    } else if (flag < 0xC0UL) {
-        READ_N(*dst, buf, 2);
-        mtr_buf->buffer_offset += 2;
-        *dst &= 0x7FFFUL;
-    } else if (flag < 0xE0UL) {
-        READ_N(*dst, buf, 3);
-        mtr_buf->buffer_offset += 3;
-        *dst &= 0x3FFFFFUL;
-    } else if (flag < 0xF0UL) {
-        READ_N(*dst, buf, 4);
-        mtr_buf->buffer_offset += 4;
-        *dst &= 0x1FFFFFFFUL;
-    } else {
-        READ_N(*dst, buf+1, 4);
-        mtr_buf->buffer_offset += 5;
+void stop_prefetch(reader_t* reader) {
+    prefetch_t* pf = reader->prefetch;
+    int i;
+    for (i=0; i<pf->depth; ++i) {
+        const struct aiocb* list[1] = { &pf->cbs[i] };
+        if (!pf->cbs[i].aio_buf) continue;
+        aio_cancel(reader->fd, &pf->cbs[i]);
+        while (aio_error(list[0]) == EINPROGRESS) aio_suspend(list, 1, NULL);
+        aio_return(&pf->cbs[i]);
     }
-    return buf;
+    free(pf->memory);
+    free(pf->cbs);
+    free(pf);
+    reader->prefetch = NULL;
 }
 
-byte* read_compressed_64(uint64_t* val, buf_t* mtr_buf) {
-    uint32_t half = 0;
+/* drop whatever is in flight and queue depth chunks starting at offset */
+void seek_prefetch(reader_t* reader, off_t offset) {
+    prefetch_t* pf = reader->prefetch;
+    int i;
+    for (i=0; i<pf->depth; ++i) {
+        const struct aiocb* list[1] = { &pf->cbs[i] };
+        if (!pf->cbs[i].aio_buf) continue;
+        while (aio_error(list[0]) == EINPROGRESS) aio_suspend(list, 1, NULL);
+        aio_return(&pf->cbs[i]);
+    }
+    pf->head = 0;
+    pf->chunk_len = -1;
+    pf->chunk_pos = 0;
+    pf->next_offset = offset;
+    for (i=0; i<pf->depth; ++i) submit_prefetch(reader, i);
+}
 
-    byte* buf = read_buffer_n(NULL, mtr_buf, 9);
-    if (!buf) return NULL;
+void submit_prefetch(reader_t* reader, int slot) {
+    prefetch_t* pf = reader->prefetch;
+    struct aiocb* cb = &pf->cbs[slot];
+    memset(cb, 0, sizeof(*cb));
+    cb->aio_fildes = reader->fd;
+    cb->aio_buf = pf->memory + slot * pf->chunk_size;
+    cb->aio_nbytes = pf->chunk_size;
+    cb->aio_offset = pf->next_offset;
+    pf->next_offset += pf->chunk_size;
+    if (aio_read(cb) == -1) {
+        perror("aio_read");
+        exit(2);
+    }
+    ++reader->stats.syscalls;
+}
 
-    byte* buf2 = read_compressed((uint32_t *)val, mtr_buf);
-    if (!buf2) return NULL;
-    *val <<= 32;
+/* next block at file_offset from the read-ahead ring, NULL at the end */
+byte* prefetch_block(reader_t* reader) {
+    prefetch_t* pf = reader->prefetch;
+    struct aiocb* cb = &pf->cbs[pf->head];
+    ssize_t ret;
+
+    if (pf->chunk_len >= 0 && pf->chunk_pos >= pf->chunk_len) {
+        /* chunk consumed: reuse its slot for the read depth chunks ahead */
+        submit_prefetch(reader, pf->head);
+        pf->head = (pf->head + 1) % pf->depth;
+        pf->chunk_len = -1;
+        cb = &pf->cbs[pf->head];
+    }
+    if (pf->chunk_len < 0) {
+        const struct aiocb* list[1] = { cb };
+        while (aio_error(cb) == EINPROGRESS) aio_suspend(list, 1, NULL);
+        ret = aio_return(cb);
+        if (ret < 0) {
+            errno = aio_error(cb);
+            perror("aio_read");
+            return NULL;
+        }
+        reader->stats.bytes += ret;
+        pf->chunk_len = ret - ret % OS_FILE_LOG_BLOCK_SIZE;
+        pf->chunk_pos = 0;
+    }
+    if (cb->aio_offset + pf->chunk_pos != reader->file_offset) {
+        /* the reader moved: restart the ring at the new position */
+        seek_prefetch(reader, reader->file_offset);
+        return prefetch_block(reader);
+    }
+    if (pf->chunk_pos >= pf->chunk_len) return NULL;
+
+    pf->chunk_pos += OS_FILE_LOG_BLOCK_SIZE;
+    return (byte*)cb->aio_buf + pf->chunk_pos - OS_FILE_LOG_BLOCK_SIZE;
+}
+
+off_t buf_file_offset(const buf_t* mtr_buf, const off_t pos) {
+    off_t delta = pos - mtr_buf->start_buffer_offset;
+    off_t blocks = delta / LOG_BLOCK_DATA_SIZE;
+    if (delta < 0 && delta % LOG_BLOCK_DATA_SIZE) --blocks;
+    return mtr_buf->start_file_offset
+        + blocks * OS_FILE_LOG_BLOCK_SIZE
+        + LOG_BLOCK_HDR_SIZE
+        + delta - blocks * LOG_BLOCK_DATA_SIZE;
+}
+
+uint64_t buf_lsn(const buf_t* mtr_buf, const off_t pos) {
+    return mtr_buf->start_lsn
+        + (buf_file_offset(mtr_buf, pos) - mtr_buf->start_file_offset);
+}
+
+/* recv_calc_lsn_on_data_add: the LSN len bytes of records after lsn */
+uint64_t lsn_add_data(uint64_t lsn, uint64_t len) {
+    uint64_t frag_len = lsn % OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE;
+    return lsn + len + (len + frag_len) / LOG_BLOCK_DATA_SIZE
+        * (LOG_BLOCK_HDR_SIZE + LOG_BLOCK_TRL_SIZE);
+}
+
+/* record bytes between two file offsets, both in the data part of a block */
+off_t log_data_len(const off_t from, const off_t to) {
+    return (to - to % OS_FILE_LOG_BLOCK_SIZE - (from - from % OS_FILE_LOG_BLOCK_SIZE))
+        / OS_FILE_LOG_BLOCK_SIZE * LOG_BLOCK_DATA_SIZE
+        + to % OS_FILE_LOG_BLOCK_SIZE - from % OS_FILE_LOG_BLOCK_SIZE;
+}
+
+int init_buffer(buf_t* mtr_buf, ssize_t size) {
+    memset(mtr_buf, 0, sizeof(*mtr_buf));
+    mtr_buf->memory_size = size - size % OS_FILE_LOG_BLOCK_SIZE;
+    /* the fixed-width loads may look a few bytes past buffer_len */
+    mtr_buf->memory = malloc(mtr_buf->memory_size + sizeof(uint64_t));
+    if (!mtr_buf->memory) {
+        perror("malloc");
+        return 0;
+    }
+    mtr_buf->buffer = mtr_buf->memory;
+    mtr_buf->mark = -1;
+    mtr_buf->at_group = 1;
+    return 1;
+}
+
+void free_buffer(buf_t* mtr_buf) {
+    free(mtr_buf->memory);
+    mtr_buf->memory = mtr_buf->buffer = NULL;
+}
+
+/* "65536", "512K", "4M", "1G"; -1 if str is not one of those */
+ssize_t parse_size(const char* str) {
+    char* end;
+    int shift = 0;
+    long long size;
+    errno = 0;
+    size = strtoll(str, &end, 10);
+    if (end == str || errno == ERANGE || size < 0) return -1;
+    switch (*end) {
+        case 'g': case 'G': shift += 10; /* fall through */
+        case 'm': case 'M': shift += 10; /* fall through */
+        case 'k': case 'K': shift += 10; ++end;
+    }
+    if (*end || size > (long long)(SSIZE_MAX >> shift)) return -1;
+    return (ssize_t)size << shift;
+}
+
+int stat_log_file(reader_t* reader, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        return 0;
+    }
+    reader->log_size = st.st_size;
+    return 1;
+}
 
-    buf2 = read_buffer_n(&half, mtr_buf, 4);
-    if (!buf2) return NULL;
-    *val |= half;
+byte* map_log_file(reader_t* reader, int fd) {
+    byte* map = mmap(NULL, reader->log_size, PROT_READ, MAP_SHARED, fd, 0);
+    ++reader->stats.syscalls;
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    if (madvise(map, reader->log_size, MADV_SEQUENTIAL) == -1)
+        perror("madvise");
+    ++reader->stats.syscalls;
+    return map;
+}
+
+/* mmap mode: point the buffer straight at the block payload when the next
+ * n bytes lie within one block, and copy only the bytes of a read that
+ * straddles block boundaries into mtr_buf->memory */
+void map_block_into_buffer(reader_t* reader, const ssize_t n) {
+    buf_t* mtr_buf = &reader->buf;
+    block_hdr block_header;
+    const byte* map;
+    off_t pos, block, end;
+    ssize_t len = 0, incr_len;
+
+    if (mtr_buf->buffer_offset > mtr_buf->buffer_len) {
+        mtr_buf->buffer_offset = mtr_buf->buffer_len = 0;
+        return;
+    }
+    /* file offset of the first byte not consumed yet, or of the first
+     * record group */
+    pos = mtr_buf->at_group ? reader->file_offset + LOG_BLOCK_HDR_SIZE : B2F(mtr_buf);
+
+    while (len < n && len < mtr_buf->memory_size) {
+        block = pos - pos % OS_FILE_LOG_BLOCK_SIZE;
+        if (reader->end_offset && block >= range_read_end(reader)) break;
+        map = map_block(reader, block);
+        if (!map) break;
+
+        parse_block_header(map, &block_header);
+        if (!block_in_log(reader, block, map, &block_header)) break;
+        if (block >= reader->file_offset) {
+            reader->file_offset = block + OS_FILE_LOG_BLOCK_SIZE;
+            ++reader->stats.blocks;
+            reader->stats.bytes += OS_FILE_LOG_BLOCK_SIZE;
+            if (reader->index) index_block(reader, block, &block_header);
+        }
+        if (mtr_buf->at_group) {
+            if (!block_header.first_rec_group) {
+                pos = block + OS_FILE_LOG_BLOCK_SIZE + LOG_BLOCK_HDR_SIZE;
+                continue;
+            }
+            pos = block + block_header.first_rec_group;
+            mtr_buf->at_group = 0;
+        }
+
+        end = block + block_header.block_data_len;
+        if (block_header.block_data_len >= OS_FILE_LOG_BLOCK_SIZE)
+            end = block + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE;
+        if (pos >= end) {
+            pos = block + OS_FILE_LOG_BLOCK_SIZE + LOG_BLOCK_HDR_SIZE;
+            continue;
+        }
+
+        if (len == 0 && end - pos >= n) {
+            mtr_buf->buffer = (byte*)map + LOG_BLOCK_HDR_SIZE;
+            mtr_buf->buffer_len = end - block - LOG_BLOCK_HDR_SIZE;
+            mtr_buf->buffer_offset = pos - block - LOG_BLOCK_HDR_SIZE;
+            mtr_buf->start_file_offset = block;
+            mtr_buf->start_buffer_offset = 0;
+            mtr_buf->start_lsn = block_no_to_lsn(reader, block_header.block_no);
+            return;
+        }
+        if (len == 0) {
+            /* B2F still holds: the copy starts inside this block */
+            mtr_buf->start_file_offset = block;
+            mtr_buf->start_lsn = block_no_to_lsn(reader, block_header.block_no);
+            mtr_buf->start_buffer_offset = block + LOG_BLOCK_HDR_SIZE - pos;
+        }
+
+        incr_len = end - pos;
+        if (incr_len > n - len) incr_len = n - len;
+        if (incr_len > mtr_buf->memory_size - len)
+            incr_len = mtr_buf->memory_size - len;
+        memcpy(mtr_buf->memory + len, map + pos - block, incr_len);
+        reader->stats.compacted += incr_len;
+        len += incr_len;
+        pos = block + OS_FILE_LOG_BLOCK_SIZE + LOG_BLOCK_HDR_SIZE;
+    }
+
+    mtr_buf->buffer = mtr_buf->memory;
+    mtr_buf->buffer_len = len;
+    mtr_buf->buffer_offset = 0;
+}
+
+byte* read_compressed(uint32_t* dst, reader_t* reader) {
+    buf_t* mtr_buf = &reader->buf;
+    byte* buf = read_buffer_n(NULL, reader, 5);
+    ssize_t len;
+    if (!buf) return NULL;
+
+    /* fewer than 5 bytes may be left at the end of the log */
+    len = mach_parse_compressed(dst, buf, mtr_buf->buffer + mtr_buf->buffer_len);
+    if (!len) return NULL;
+    mtr_buf->buffer_offset += len;
+    return buf;
+}
+
+byte* read_compressed_64(uint64_t* val, reader_t* reader) {
+    buf_t* mtr_buf = &reader->buf;
+    uint32_t high;
+
+    byte* buf = read_buffer_n(NULL, reader, 9);
+    if (!buf) return NULL;
+
+    ssize_t len = mach_parse_compressed(&high, buf, mtr_buf->buffer + mtr_buf->buffer_len);
+    if (!len || mtr_buf->buffer_offset + len + 4 > mtr_buf->buffer_len) return NULL;
+    *val = (uint64_t)high << 32 | mach_read_4(buf + len);
+    mtr_buf->buffer_offset += len + 4;
 
     return buf;
 }
 
-void parse_log_header() {
+int parse_log_header(reader_t* reader) {
     byte log_hdr_buf[LOG_FILE_HDR_SIZE];
-    long ret = pread(fd, &log_hdr_buf, LOG_FILE_HDR_SIZE, 0);
-    assert(ret == LOG_FILE_HDR_SIZE);
-    file_offset = LOG_FILE_HDR_SIZE;
+    log_hdr* log_header = &reader->header;
+    long ret = pread(reader->fd, &log_hdr_buf, LOG_FILE_HDR_SIZE, 0);
+    if (ret != LOG_FILE_HDR_SIZE) return 0;
+    reader->file_offset = LOG_FILE_HDR_SIZE;
+    reader->start_offset = LOG_FILE_HDR_SIZE;
+
+    READ(log_header->log_group_id, log_hdr_buf + LOG_GROUP_ID);
+    READ(log_header->start_lsn, log_hdr_buf    + LOG_FILE_START_LSN);
+    READ(log_header->log_file_no, log_hdr_buf  + LOG_FILE_NO);
+    READ(log_header->arch_completed, log_hdr_buf + LOG_FILE_ARCH_COMPLETED);
+    READ(log_header->end_lsn, log_hdr_buf        + LOG_FILE_END_LSN);
+    READ(log_header->checkpoint1, log_hdr_buf    + LOG_CHECKPOINT_1);
+    READ(log_header->checkpoint2, log_hdr_buf    + LOG_CHECKPOINT_2);
+    return 1;
+}
+
+/* ut_fold_binary, with a 64-bit ulint */
+uint64_t fold_binary(const byte* str, size_t len) {
+    uint64_t fold = 0;
+    while (len--) {
+        fold = ((((fold ^ *str ^ UT_HASH_RANDOM_MASK2) << 8) + fold)
+                ^ UT_HASH_RANDOM_MASK) + *str;
+        ++str;
+    }
+    return fold;
+}
+
+/* recv_check_cp_is_consistent */
+static int checkpoint_is_consistent(const byte* cp_buf) {
+    uint32_t checksum;
+    READ(checksum, cp_buf + LOG_CHECKPOINT_CHECKSUM_1);
+    if ((uint32_t)fold_binary(cp_buf, LOG_CHECKPOINT_CHECKSUM_1) != checksum)
+        return 0;
+    READ(checksum, cp_buf + LOG_CHECKPOINT_CHECKSUM_2);
+    return (uint32_t)fold_binary(cp_buf + LOG_CHECKPOINT_LSN,
+            LOG_CHECKPOINT_CHECKSUM_2 - LOG_CHECKPOINT_LSN) == checksum;
+}
 
-    log_hdr log_header;
-    READ(log_header.log_group_id, log_hdr_buf + LOG_GROUP_ID);
-    READ(log_header.start_lsn, log_hdr_buf    + LOG_FILE_START_LSN);
-    READ(log_header.log_file_no, log_hdr_buf  + LOG_FILE_NO);
-    READ(log_header.arch_completed, log_hdr_buf + LOG_FILE_ARCH_COMPLETED);
-    READ(log_header.end_lsn, log_hdr_buf        + LOG_FILE_END_LSN);
-    READ(log_header.checkpoint1, log_hdr_buf    + LOG_CHECKPOINT_1);
-    READ(log_header.checkpoint2, log_hdr_buf    + LOG_CHECKPOINT_2);
+/* read the checkpoint field at offset of the first file, 0 when it cannot
+ * be read or its checksums do not match. A 5.6 field has the two fold
+ * checksums, a 5.7 one is a whole block with the block checksum and an
+ * 8-byte offset */
+int parse_checkpoint(reader_t* reader, off_t offset, checkpoint_t* checkpoint) {
+    byte cp_buf[OS_FILE_LOG_BLOCK_SIZE];
+    uint32_t low, high;
+    ++reader->stats.syscalls;
+    if (pread(reader->fd, cp_buf, OS_FILE_LOG_BLOCK_SIZE, offset) != OS_FILE_LOG_BLOCK_SIZE)
+        return 0;
+
+    READ(checkpoint->no, cp_buf           + LOG_CHECKPOINT_NO);
+    READ(checkpoint->lsn, cp_buf          + LOG_CHECKPOINT_LSN);
+    if (checkpoint_is_consistent(cp_buf)) {
+        READ(low, cp_buf                      + LOG_CHECKPOINT_OFFSET_LOW32);
+        READ(high, cp_buf                     + LOG_CHECKPOINT_OFFSET_HIGH32);
+        READ(checkpoint->log_buf_size, cp_buf + LOG_CHECKPOINT_LOG_BUF_SIZE);
+        READ(checkpoint->archived_lsn, cp_buf + LOG_CHECKPOINT_ARCHIVED_LSN);
+        checkpoint->offset = (off_t)high << 32 | low;
+        return 1;
+    }
+    /* a field never written is all zeros and would pass as old format */
+    if (!mach_read_4(cp_buf + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_CHECKSUM)
+        || !log_block_checksum_is_ok(reader, cp_buf))
+        return 0;
+    checkpoint->offset = (off_t)mach_read_8(cp_buf + LOG_CHECKPOINT_OFFSET);
+    READ(checkpoint->log_buf_size, cp_buf  + LOG_CHECKPOINT_BUF_SIZE_57);
+    checkpoint->archived_lsn = 0;
+    return 1;
+}
 
-    show_log_header(&log_header);
+/* recv_find_max_checkpoint: the valid checkpoint field with the highest
+ * number goes into reader->checkpoint, 0 if neither is valid */
+int read_checkpoint(reader_t* reader) {
+    checkpoint_t cp1, cp2;
+    int valid1 = parse_checkpoint(reader, LOG_CHECKPOINT_1, &cp1);
+    int valid2 = parse_checkpoint(reader, LOG_CHECKPOINT_2, &cp2);
+    if (valid1 && (!valid2 || cp1.no >= cp2.no)) reader->checkpoint = cp1;
+    else if (valid2) reader->checkpoint = cp2;
+    else return 0;
+    return 1;
 }
 
 void parse_block_header(const byte* buffer, block_hdr* block_header) {
@@ -625,171 +1762,1302 @@ void parse_block_header(const byte* buffer, block_hdr* block_header) {
 #endif
 }
 
-byte* parse_index(const uint8_t comp, buf_t* mtr_buf) {
-    uint16_t idx_num, uniq_idx_num, i, column_len;
-    byte* buf_ptr = mtr_buf->buffer + mtr_buf->buffer_offset;
+/* dict_index_t written by mlog_open_and_write_index; the column lengths
+ * are kept as a view */
+int parse_index(const uint8_t comp, reader_t* reader, s_mtr_t* mtr) {
+    mtr_index_t* index = &mtr->index;
     if (comp) {
-        buf_ptr = read_buffer_n(&idx_num, mtr_buf, 2);
-        if (!buf_ptr) return NULL;
+        if (!read_buffer_n(&index->n_fields, reader, 2)) return 0;
+        if (!read_buffer_n(&index->n_uniq, reader, 2)) return 0;
+        return read_view(&index->fields, reader, index->n_fields * 2);
+    }
+    index->n_fields = index->n_uniq = 1;
+    return 1;
+}
+
+int parse_insert_rec(reader_t* reader, mtr_insert_t* rec) {
+    uint32_t end_seg_len;
+    if (!read_compressed(&end_seg_len, reader)) return 0;
+
+    rec->has_origin = end_seg_len & 0x1UL;
+    if (rec->has_origin) {
+        if (!read_buffer_n(&rec->info_status_bits, reader, 1)) return 0;
+        if (!read_compressed(&rec->origin_offset, reader)) return 0;
+        if (!read_compressed(&rec->mismatch_index, reader)) return 0;
+    }
+    return read_view(&rec->end_seg, reader, end_seg_len >> 1);
+}
+
+/* parse_insert_rec from memory up to end, for the records of
+ * MLOG_LIST_END_COPY_CREATED; returns the length of the record, 0 if it
+ * does not fit. The offset of the end segment view is not known here and
+ * left at -1 */
+size_t decode_insert_rec(const byte* ptr, const byte* end, mtr_insert_t* rec) {
+    const byte* start = ptr;
+    uint32_t end_seg_len;
+    ssize_t len;
+
+    if (!(len = mach_parse_compressed(&end_seg_len, ptr, end))) return 0;
+    ptr += len;
+    rec->has_origin = end_seg_len & 0x1UL;
+    if (rec->has_origin) {
+        if (ptr == end) return 0;
+        rec->info_status_bits = *ptr++;
+        if (!(len = mach_parse_compressed(&rec->origin_offset, ptr, end))) return 0;
+        ptr += len;
+        if (!(len = mach_parse_compressed(&rec->mismatch_index, ptr, end))) return 0;
+        ptr += len;
+    }
+    if ((size_t)(end - ptr) < end_seg_len >> 1) return 0;
+    rec->end_seg.data = ptr;
+    rec->end_seg.len = end_seg_len >> 1;
+    rec->end_seg.offset = -1;
+    return ptr + rec->end_seg.len - start;
+}
 
-        buf_ptr = read_buffer_n(&uniq_idx_num, mtr_buf, 2);
-        if (!buf_ptr) return NULL;
+/* row_upd_parse_sys_vals: TRX_ID position, roll pointer and TRX_ID */
+int parse_trx_id(reader_t* reader, mtr_update_t* upd) {
+    if (!read_compressed(&upd->trx_id_pos, reader)) return 0;
+    if (!read_buffer_n(&upd->roll_ptr, reader, DATA_ROLL_PTR_LEN)) return 0;
+    return read_compressed_64(&upd->trx_id, reader) != NULL;
+}
+
+int read_page_offset(reader_t* reader, s_mtr_t* mtr) {
+    uint16_t page_offset;
+    if (!read_buffer_n(&page_offset, reader, 2)) return 0;
+    mtr->page_offset = page_offset;
+    return 1;
+}
+
+/* consume len bytes of the record body as a view; its data pointer is set
+ * by resolve_view once the whole body is in place, or left NULL when the
+ * body stays in the file */
+int read_view(view_t* view, reader_t* reader, size_t len) {
+    view->offset = B2F(&reader->buf);
+    view->len = len;
+    return skip_buffer_n(reader, len);
+}
+
+void resolve_view(view_t* view, const view_t* payload) {
+    if (view->len)
+        view->data = payload->data
+            ? payload->data + log_data_len(payload->offset, view->offset) : NULL;
+}
+
+/* consume len bytes, which need not fit in the buffer at once */
+int skip_buffer_n(reader_t* reader, size_t len) {
+    buf_t* mtr_buf = &reader->buf;
+    ssize_t n;
+    while (len > 0) {
+        n = len < (size_t)mtr_buf->memory_size ? len : mtr_buf->memory_size;
+        if (!read_buffer_n(NULL, reader, n)) return 0;
+        if (n > mtr_buf->buffer_len - mtr_buf->buffer_offset)
+            n = mtr_buf->buffer_len - mtr_buf->buffer_offset;
+        if (n <= 0) return 0;
+        mtr_buf->buffer_offset += n;
+        len -= n;
+    }
+    return 1;
+}
+
+void out_reserve(out_buf_t* out, size_t n) {
+    if (out->len + n <= out->size) return;
+    while (out->len + n > out->size)
+        out->size = out->size ? out->size * 2 : OUTPUT_FLUSH_SIZE * 2;
+    out->data = realloc(out->data, out->size);
+    if (!out->data) {
+        perror("realloc");
+        exit(2);
+    }
+}
+
+/* start reading the bytes of a view, in memory or not */
+void payload_open(payload_cursor_t* cursor, reader_t* reader, const view_t* view) {
+    cursor->reader = reader;
+    cursor->data = view->data;
+    cursor->offset = view->offset;
+    cursor->left = view->len;
+    cursor->chunk_offset = 0;
+    cursor->chunk_len = 0;
+}
+
+/* the next segment of the view into *data: the whole view when it is in
+ * memory, otherwise the part in one block, in the mapping or in the chunk
+ * read with one pread. 0 at the end, or when the log cannot be read */
+size_t payload_next(payload_cursor_t* cursor, const byte** data) {
+    reader_t* reader = cursor->reader;
+    const byte* block;
+    off_t block_offset, pos, left;
+    ssize_t ret;
+    size_t n;
+    int file;
+
+    if (cursor->left == 0) return 0;
+    if (cursor->data) {
+        *data = cursor->data;
+        n = cursor->left;
+        cursor->left = 0;
+        return n;
+    }
+    block_offset = cursor->offset - cursor->offset % OS_FILE_LOG_BLOCK_SIZE;
+    if (reader->log_map) {
+        block = map_block(reader, block_offset);
+        if (!block) return 0;
     } else {
-        idx_num = uniq_idx_num = 1;
+        if (block_offset < cursor->chunk_offset
+            || block_offset >= cursor->chunk_offset + cursor->chunk_len) {
+            /* in group mode a read stops at the end of the file */
+            file = locate_block(reader, block_offset, &pos, &left);
+            n = left < PAYLOAD_CHUNK_SIZE ? left : PAYLOAD_CHUNK_SIZE;
+            ret = pread(reader->fds[file], cursor->chunk, n, pos);
+            ++reader->stats.syscalls;
+            if (ret < OS_FILE_LOG_BLOCK_SIZE) return 0;
+            reader->stats.bytes += ret;
+            cursor->chunk_offset = block_offset;
+            cursor->chunk_len = ret - ret % OS_FILE_LOG_BLOCK_SIZE;
+        }
+        block = cursor->chunk + (block_offset - cursor->chunk_offset);
     }
-    print_log(0, "number of columns in index: %"PRIu16"\n"
-           "number of columns in unique index: %"PRIu16"\n",
-           idx_num, uniq_idx_num);
-    byte *ret_ptr = buf_ptr;
-    if (comp) {
-        for (i=0; i<idx_num; ++i) {
-            buf_ptr = read_buffer_n(&column_len, mtr_buf, 2);
-            if (!buf_ptr) return NULL;
-            /* The high-order bit of len is the NOT NULL flag;
-             * the rest is 0 or 0x7fff for variable-length fields,
-             * 1..0x7ffe for fixed-length fields. */
-            print_log(0, "%"PRIu16" column in index", i);
-            print_log(0, " > nullable: %s",
-                    column_len & 0x8000 ? "no" : "yes");
-            print_log(0, " > fixed/variable len: %s\n",
-                    ((column_len + 1) & 0x7fff) <= 1 ?
-                    "variable" : "fixed");
+    n = block_offset + OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_TRL_SIZE - cursor->offset;
+    if (n > cursor->left) n = cursor->left;
+    *data = block + (cursor->offset - block_offset);
+    cursor->left -= n;
+    cursor->offset = block_offset + OS_FILE_LOG_BLOCK_SIZE + LOG_BLOCK_HDR_SIZE;
+    return n;
+}
+
+/* copy a view to dst, 0 when the log cannot be read */
+int copy_view(reader_t* reader, const view_t* view, byte* dst) {
+    payload_cursor_t cursor;
+    const byte* data;
+    size_t n;
+
+    if (view->data) {
+        memcpy(dst, view->data, view->len);
+        return 1;
+    }
+    payload_open(&cursor, reader, view);
+    while ((n = payload_next(&cursor, &data))) {
+        memcpy(dst, data, n);
+        dst += n;
+    }
+    return cursor.left == 0;
+}
+
+/* the bytes of a view in one piece, for the fields that are decoded when
+ * the record is shown: copied into reader->payload_copy when they are not
+ * in memory, and valid until the next call */
+const byte* view_bytes(reader_t* reader, const view_t* view) {
+    out_buf_t* copy = &reader->payload_copy;
+    if (view->data || !view->len) return view->data;
+    copy->len = 0;
+    out_reserve(copy, view->len);
+    if (!copy_view(reader, view, copy->data))
+        memset(copy->data, 0, view->len);
+    return copy->data;
+}
+
+/* append one record to the output buffer in the selected format, and write
+ * the buffer out once it is large enough; the payload goes in segment by
+ * segment, so a body that is not in memory is never gathered */
+void emit_record(reader_t* reader, const s_mtr_t* mtr) {
+    static const char hex[] = "0123456789abcdef";
+    const int json = reader->opt.output_format == OUTPUT_JSON;
+    const size_t len = mtr->payload.len;
+    payload_cursor_t cursor;
+    const byte* payload;
+    byte* ptr;
+    size_t i, n, done = 0;
+
+    out_reserve(&reader->rec_out, 256);
+    ptr = reader->rec_out.data + reader->rec_out.len;
+    if (json) {
+        ptr += sprintf((char*)ptr,
+                "{\"type\":\"%s\",\"type_no\":%"PRIu8",\"single\":%s,"
+                "\"space_id\":%"PRIu32",\"page_no\":%"PRIu32",",
+                mtr_type_name(mtr), mtr->type & (byte)~MLOG_SINGLE_REC_FLAG,
+                mtr_is_single_rec(mtr) ? "true" : "false",
+                mtr->space_id, mtr->page_no);
+        if (mtr->page_offset >= 0)
+            ptr += sprintf((char*)ptr, "\"page_offset\":%"PRId32",", mtr->page_offset);
+        else
+            ptr += sprintf((char*)ptr, "\"page_offset\":null,");
+        ptr += sprintf((char*)ptr,
+                "\"lsn\":%"PRIu64",\"offset\":%lld,\"payload\":\"",
+                mtr->lsn, (long long)mtr->offset);
+    } else {
+        ptr = write_be(ptr, BINARY_RECORD_HDR_SIZE - 4 + len, 4);
+        ptr = write_be(ptr, mtr->type & (byte)~MLOG_SINGLE_REC_FLAG, 1);
+        ptr = write_be(ptr, mtr_is_single_rec(mtr), 1);
+        ptr = write_be(ptr, mtr->page_offset >= 0 ? mtr->page_offset : 0xFFFF, 2);
+        ptr = write_be(ptr, mtr->space_id, 4);
+        ptr = write_be(ptr, mtr->page_no, 4);
+        ptr = write_be(ptr, mtr->lsn, 8);
+        ptr = write_be(ptr, mtr->offset, 8);
+        ptr = write_be(ptr, len, 4);
+    }
+    reader->rec_out.len = ptr - reader->rec_out.data;
+
+    payload_open(&cursor, reader, &mtr->payload);
+    while (1) {
+        n = payload_next(&cursor, &payload);
+        /* the log could not be read: zeros keep the length written */
+        if (n == 0 && done < len) {
+            payload = NULL;
+            n = len - done;
         }
+        if (n == 0) break;
+        out_reserve(&reader->rec_out, json ? n * 2 : n);
+        ptr = reader->rec_out.data + reader->rec_out.len;
+        if (!payload) {
+            memset(ptr, json ? '0' : 0, json ? n * 2 : n);
+            ptr += json ? n * 2 : n;
+        } else if (json) {
+            for (i=0; i<n; ++i) {
+                *ptr++ = hex[payload[i] >> 4];
+                *ptr++ = hex[payload[i] & 0xF];
+            }
+        } else {
+            memcpy(ptr, payload, n);
+            ptr += n;
+        }
+        done += n;
+        reader->rec_out.len = ptr - reader->rec_out.data;
+        if (reader->rec_out.len >= OUTPUT_FLUSH_SIZE) flush_records(reader);
     }
-    return ret_ptr;
+    if (json) {
+        out_reserve(&reader->rec_out, 3);
+        ptr = reader->rec_out.data + reader->rec_out.len;
+        *ptr++ = '"';
+        *ptr++ = '}';
+        *ptr++ = '\n';
+        reader->rec_out.len = ptr - reader->rec_out.data;
+    }
+    if (reader->rec_out.len >= OUTPUT_FLUSH_SIZE) flush_records(reader);
 }
 
-ssize_t parse_insert_rec(const uint8_t is_short, buf_t* mtr_buf) {
-    byte* buf_ptr;
-    off_t saved_offset;
-    ssize_t bytes_count = 0;
+void flush_records(reader_t* reader) {
+    if (reader->rec_out.len == 0) return;
+    fwrite(reader->rec_out.data, 1, reader->rec_out.len, reader->opt.out);
+    reader->rec_out.len = 0;
+}
 
-    uint16_t page_offset;
-    if (!is_short) {
-        buf_ptr = read_buffer_n(&page_offset, mtr_buf, 2);
-        if (!buf_ptr) return 0;
-        bytes_count += 2;
-        print_log(0, "page offset: %"PRIu16"\n", page_offset);
+/* count a record by type and by mini-transaction: a record with the single
+ * flag is one, the others run to the next MLOG_MULTI_REC_END */
+void log_stat_add(log_stat_t* stat, const s_mtr_t* mtr) {
+    byte type = mtr->type & (byte)~MLOG_SINGLE_REC_FLAG;
+    mtr_stat_t* mtr_stat;
+    int bucket = 0;
+
+    ++stat->records;
+    stat->bytes += mtr->len;
+    if (type <= MLOG_BIGGEST_TYPE) {
+        ++stat->types[type].records;
+        stat->types[type].bytes += mtr->len;
     }
+    stat->open_records += 1;
+    stat->open_bytes += mtr->len;
+    if (!mtr_is_single_rec(mtr) && type != MLOG_MULTI_REC_END) return;
+
+    mtr_stat = mtr_is_single_rec(mtr) ? &stat->single : &stat->multi;
+    ++mtr_stat->count;
+    mtr_stat->records += stat->open_records;
+    mtr_stat->bytes += stat->open_bytes;
+    if (stat->open_bytes > mtr_stat->max_bytes) mtr_stat->max_bytes = stat->open_bytes;
+    while (bucket < MTR_SIZE_BUCKETS - 1 && stat->open_bytes >> (bucket + 1)) ++bucket;
+    ++mtr_stat->sizes[bucket];
+    stat->open_records = stat->open_bytes = 0;
+}
 
-    saved_offset = mtr_buf->buffer_offset;
-    uint32_t end_seg_len;
-    buf_ptr = read_compressed(&end_seg_len, mtr_buf);
-    if (!buf_ptr) return bytes_count;
-    bytes_count += (mtr_buf->buffer_offset - saved_offset);
-
-    if (end_seg_len & 0x1UL) {
-        uint8_t info_and_status_bits;
-        buf_ptr = read_buffer_n(&info_and_status_bits, mtr_buf, 1);
-        if (!buf_ptr) return bytes_count;
-        bytes_count += 1;
-
-        saved_offset = mtr_buf->buffer_offset;
-        uint32_t origin_offset;
-        buf_ptr = read_compressed(&origin_offset, mtr_buf);
-        if (!buf_ptr) return bytes_count;
-        bytes_count += (mtr_buf->buffer_offset - saved_offset);
-
-        saved_offset = mtr_buf->buffer_offset;
-        uint32_t mismatch_index;
-        buf_ptr = read_compressed(&mismatch_index, mtr_buf);
-        if (!buf_ptr) return bytes_count;
-        bytes_count += (mtr_buf->buffer_offset - saved_offset);
-
-        print_log(0, "origin  offset: %"PRIu32"\n"
-               "mismatch index: %"PRIu32"\n",
-               origin_offset, mismatch_index);
+static void mtr_stat_merge(mtr_stat_t* to, const mtr_stat_t* from) {
+    int i;
+    to->count += from->count;
+    to->records += from->records;
+    to->bytes += from->bytes;
+    if (from->max_bytes > to->max_bytes) to->max_bytes = from->max_bytes;
+    for (i=0; i<MTR_SIZE_BUCKETS; ++i) to->sizes[i] += from->sizes[i];
+}
+
+/* add the counts of from, which must have been taken over the log that
+ * follows the one of to */
+void log_stat_merge(log_stat_t* to, const log_stat_t* from) {
+    int i;
+    to->records += from->records;
+    to->bytes += from->bytes;
+    for (i=0; i<=MLOG_BIGGEST_TYPE; ++i) {
+        to->types[i].records += from->types[i].records;
+        to->types[i].bytes += from->types[i].bytes;
+    }
+    mtr_stat_merge(&to->single, &from->single);
+    mtr_stat_merge(&to->multi, &from->multi);
+    to->open_records = from->open_records;
+    to->open_bytes = from->open_bytes;
+}
+
+/* bump allocator over large blocks, freed all at once */
+void* arena_alloc(arena_t* arena, size_t size) {
+    byte* block;
+    size = (size + 7) & ~(size_t)7;
+    if (arena->used + size > arena->size) {
+        arena->size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(byte*) + arena->size);
+        if (!block) {
+            perror("malloc");
+            exit(2);
+        }
+        /* the blocks are chained through their first word */
+        *(byte**)block = arena->block;
+        arena->block = block;
+        arena->used = 0;
+        arena->total += sizeof(byte*) + arena->size;
+    }
+    arena->used += size;
+    return arena->block + sizeof(byte*) + arena->used - size;
+}
+
+void arena_free(arena_t* arena) {
+    byte* block;
+    while ((block = arena->block)) {
+        arena->block = *(byte**)block;
+        free(block);
+    }
+    arena->used = arena->size = arena->total = 0;
+}
+
+int page_index_init(page_index_t* pages) {
+    memset(pages, 0, sizeof(*pages));
+    pages->size = PAGE_INDEX_INIT_SIZE;
+    pages->slots = calloc(pages->size, sizeof(*pages->slots));
+    if (!pages->slots) {
+        perror("malloc");
+        return 0;
+    }
+    return 1;
+}
+
+void page_index_free(page_index_t* pages) {
+    free(pages->slots);
+    arena_free(&pages->arena);
+    memset(pages, 0, sizeof(*pages));
+}
+
+/* Fibonacci hashing: the top bits of the product depend on all of the key */
+static size_t page_hash(uint32_t space_id, uint32_t page_no, size_t size) {
+    uint64_t key = (uint64_t)space_id << 32 | page_no;
+    return key * 0x9E3779B97F4A7C15ULL >> (64 - __builtin_ctzll(size));
+}
+
+/* linear probing: the slot of the page, or the free slot where it goes */
+static page_stat_t* page_slot(page_stat_t* slots, size_t size,
+        uint32_t space_id, uint32_t page_no) {
+    size_t i = page_hash(space_id, page_no, size);
+    while (slots[i].records
+        && (slots[i].space_id != space_id || slots[i].page_no != page_no))
+        i = (i + 1) & (size - 1);
+    return &slots[i];
+}
+
+static void page_index_grow(page_index_t* pages) {
+    size_t size = pages->size * 2, i;
+    page_stat_t* slots = calloc(size, sizeof(*slots));
+    if (!slots) {
+        perror("malloc");
+        exit(2);
+    }
+    for (i=0; i<pages->size; ++i) {
+        const page_stat_t* page = &pages->slots[i];
+        if (page->records)
+            *page_slot(slots, size, page->space_id, page->page_no) = *page;
+    }
+    free(pages->slots);
+    pages->slots = slots;
+    pages->size = size;
+}
+
+/* count a record against its page and append its LSN and type to the
+ * list of the page, and with keep_records a copy of the record to its
+ * chain; records without a page are ignored */
+void page_index_add(page_index_t* pages, const s_mtr_t* mtr) {
+    byte type = mtr->type & (byte)~MLOG_SINGLE_REC_FLAG;
+    page_stat_t* page;
+    page_chunk_t* chunk;
+    recv_t* recv;
+
+    if (type == MLOG_MULTI_REC_END || type == MLOG_DUMMY_RECORD
+        || type == MLOG_CHECKPOINT)
+        return;
+    /* at most 3/4 full */
+    if ((pages->n + 1) * 4 > pages->size * 3) page_index_grow(pages);
+
+    page = page_slot(pages->slots, pages->size, mtr->space_id, mtr->page_no);
+    if (!page->records) {
+        page->space_id = mtr->space_id;
+        page->page_no = mtr->page_no;
+        page->min_lsn = mtr->lsn;
+        ++pages->n;
+    }
+    ++page->records;
+    page->bytes += mtr->payload.len;
+    if (mtr->lsn < page->min_lsn) page->min_lsn = mtr->lsn;
+    if (mtr->lsn > page->max_lsn) page->max_lsn = mtr->lsn;
+
+    chunk = page->chunks;
+    if (!chunk || chunk->n == PAGE_CHUNK_RECORDS) {
+        chunk = arena_alloc(&pages->arena, sizeof(*chunk));
+        chunk->next = page->chunks;
+        chunk->n = 0;
+        page->chunks = chunk;
+    }
+    chunk->lsn[chunk->n] = mtr->lsn;
+    chunk->type[chunk->n] = type;
+    ++chunk->n;
+
+    /* kept records come from reader_next_mtr, whose payloads are copies */
+    if (!pages->keep_records) return;
+    recv = arena_alloc(&pages->arena, sizeof(*recv) + mtr->payload.len);
+    recv->next = NULL;
+    recv->mtr = *mtr;
+    memcpy(recv + 1, mtr->payload.data, mtr->payload.len);
+    move_payload(&recv->mtr, (byte*)(recv + 1));
+    if (page->last_rec) page->last_rec->next = recv;
+    else page->recs = recv;
+    page->last_rec = recv;
+}
+
+static int cmp_page_records(const void* a, const void* b) {
+    const page_stat_t *pa = *(page_stat_t* const*)a, *pb = *(page_stat_t* const*)b;
+    if (pa->records != pb->records) return pa->records < pb->records ? 1 : -1;
+    if (pa->space_id != pb->space_id) return pa->space_id < pb->space_id ? -1 : 1;
+    return pa->page_no < pb->page_no ? -1 : pa->page_no > pb->page_no;
+}
+
+static int cmp_page_id(const void* a, const void* b) {
+    const page_stat_t *pa = *(page_stat_t* const*)a, *pb = *(page_stat_t* const*)b;
+    if (pa->space_id != pb->space_id) return pa->space_id < pb->space_id ? -1 : 1;
+    return pa->page_no < pb->page_no ? -1 : pa->page_no > pb->page_no;
+}
+
+/* all pages->n pages, by page_order_t; free the array */
+page_stat_t** page_index_pages(const page_index_t* pages, int order) {
+    page_stat_t** list = malloc((pages->n + 1) * sizeof(*list));
+    size_t i, len = 0;
+    if (!list) {
+        perror("malloc");
+        exit(2);
+    }
+    for (i=0; i<pages->size; ++i)
+        if (pages->slots[i].records) list[len++] = &pages->slots[i];
+    qsort(list, len, sizeof(*list),
+            order == PAGE_ORDER_ID ? cmp_page_id : cmp_page_records);
+    return list;
+}
+
+static page_frame_t** frame_bucket(apply_t* apply, uint32_t page_no) {
+    return &apply->hash[page_no * 0x9E3779B97F4A7C15ULL
+        >> (64 - __builtin_ctzll(apply->hash_size))];
+}
+
+static void lru_remove(page_frame_t* frame) {
+    frame->prev->next = frame->next;
+    frame->next->prev = frame->prev;
+}
+
+static void lru_add_first(page_frame_t* head, page_frame_t* frame) {
+    frame->prev = head;
+    frame->next = head->next;
+    head->next->prev = frame;
+    head->next = frame;
+}
+
+static int page_poisoned(const apply_t* apply, uint32_t page_no) {
+    size_t i, mask = apply->poisoned_size - 1;
+    if (!apply->poisoned_size) return 0;
+    for (i = page_no * 0x9E3779B97F4A7C15ULL & mask; apply->poisoned[i];
+            i = (i + 1) & mask)
+        if (apply->poisoned[i] == page_no + 1) return 1;
+    return 0;
+}
+
+/* leave a page alone for the rest of the apply: a record of it cannot be
+ * applied, or it starts past the end of the file and has no FIL header.
+ * Its LSN must not move past changes it did not get, so it is never
+ * written again and what the cache has of it is dropped */
+static void poison_page(apply_t* apply, uint32_t page_no) {
+    page_frame_t* frame;
+    uint32_t* old = apply->poisoned;
+    size_t i, j, old_size = apply->poisoned_size, mask;
+
+    if (page_poisoned(apply, page_no)) return;
+    for (frame = *frame_bucket(apply, page_no); frame; frame = frame->hash_next)
+        if (frame->page_no == page_no) frame->dirty = 0;
+    /* at most half full */
+    if (2 * (apply->stats.poisoned + 1) > old_size) {
+        apply->poisoned_size = old_size ? old_size * 2 : 64;
+        apply->poisoned = calloc(apply->poisoned_size, sizeof(*apply->poisoned));
+        if (!apply->poisoned) {
+            perror("malloc");
+            exit(2);
+        }
+        mask = apply->poisoned_size - 1;
+        for (j=0; j<old_size; ++j) {
+            if (!old[j]) continue;
+            for (i = (old[j] - 1) * 0x9E3779B97F4A7C15ULL & mask; apply->poisoned[i];
+                    i = (i + 1) & mask);
+            apply->poisoned[i] = old[j];
+        }
+        free(old);
     }
-    end_seg_len >>= 1;
-    print_log(0, "end seg len: %"PRIu32"\n", end_seg_len);
+    mask = apply->poisoned_size - 1;
+    for (i = page_no * 0x9E3779B97F4A7C15ULL & mask; apply->poisoned[i];
+            i = (i + 1) & mask);
+    apply->poisoned[i] = page_no + 1;
+    ++apply->stats.poisoned;
+}
 
-    bytes_count += end_seg_len;
-    /* buf_ptr = read_buffer_n(buffer, buffer_offset, buffer_len, end_seg_len); */
-    /* buffer_offset += end_seg_len; */
-    /* hexdump(buf_ptr, end_seg_len); */
-    uint32_t delta;
-    while (end_seg_len > 0) {
-        buf_ptr = read_buffer_n(NULL, mtr_buf, end_seg_len);
-        if (!buf_ptr) return bytes_count - end_seg_len;
-        delta = mtr_buf->buffer_len - mtr_buf->buffer_offset < end_seg_len ?
-                mtr_buf->buffer_len - mtr_buf->buffer_offset : end_seg_len;
-        assert(delta > 0);
-        hexdump(buf_ptr, delta);
-        end_seg_len -= delta;
-        mtr_buf->buffer_offset += delta;
+/* the cached image of a page, read on a miss into a free frame or the
+ * least recently used one; pages past the end of the file start zeroed
+ * and are poisoned */
+static page_frame_t* get_frame(apply_t* apply, uint32_t page_no) {
+    page_frame_t **bucket = frame_bucket(apply, page_no), **p, *frame;
+    ssize_t ret;
+
+    for (frame = *bucket; frame; frame = frame->hash_next) {
+        if (frame->page_no != page_no) continue;
+        lru_remove(frame);
+        lru_add_first(&apply->lru, frame);
+        return frame;
     }
 
-    return bytes_count;
+    if (apply->n_used < apply->n_frames) {
+        frame = &apply->frames[apply->n_used++];
+    } else {
+        frame = apply->lru.prev;
+        if (frame->dirty && !apply_flush(apply)) return NULL;
+        for (p = frame_bucket(apply, frame->page_no); *p != frame; p = &(*p)->hash_next);
+        *p = frame->hash_next;
+        lru_remove(frame);
+    }
+    ret = pread(apply->fd, frame->page, UNIV_PAGE_SIZE, (off_t)page_no * UNIV_PAGE_SIZE);
+    ++apply->stats.syscalls;
+    if (ret == -1) {
+        perror("pread");
+        return NULL;
+    }
+    memset(frame->page + ret, 0, UNIV_PAGE_SIZE - ret);
+    ++apply->stats.reads;
+    if (ret < UNIV_PAGE_SIZE) poison_page(apply, page_no);
+    frame->page_no = page_no;
+    frame->dirty = 0;
+    frame->hash_next = *bucket;
+    *bucket = frame;
+    lru_add_first(&apply->lru, frame);
+    return frame;
 }
 
-void show_usages(void) {
-    print_log(0, "Usages: redo-log-reader /path/to/ib_logfile\n");
+/* open a tablespace for apply_mtr with a cache of n_pages pages; the
+ * space id comes from page 0 */
+apply_t* apply_open(const char* path, size_t n_pages) {
+    apply_t* apply = calloc(1, sizeof(*apply));
+    page_frame_t* frame;
+    struct stat st;
+    size_t i;
+
+    if (!apply) {
+        perror("malloc");
+        return NULL;
+    }
+    apply->fd = open(path, O_RDWR);
+    if (apply->fd == -1) {
+        perror("open");
+        free(apply);
+        return NULL;
+    }
+    if (fstat(apply->fd, &st) == -1) {
+        perror("fstat");
+        goto fail;
+    }
+    if (st.st_size < UNIV_PAGE_SIZE) {
+        fprintf(stderr, "%s: not a tablespace of %d byte pages\n", path, UNIV_PAGE_SIZE);
+        goto fail;
+    }
+
+    if (n_pages < 1) n_pages = 1;
+    apply->n_frames = n_pages;
+    for (apply->hash_size = 2; apply->hash_size < n_pages * 2; apply->hash_size <<= 1);
+    apply->frames = calloc(n_pages, sizeof(*apply->frames));
+    apply->hash = calloc(apply->hash_size, sizeof(*apply->hash));
+    if (!apply->frames || !apply->hash
+        || posix_memalign((void**)&apply->pages, UNIV_PAGE_SIZE, n_pages * UNIV_PAGE_SIZE)) {
+        perror("malloc");
+        exit(2);
+    }
+    for (i=0; i<n_pages; ++i) apply->frames[i].page = apply->pages + i * UNIV_PAGE_SIZE;
+    apply->lru.prev = apply->lru.next = &apply->lru;
+
+    frame = get_frame(apply, 0);
+    if (!frame) goto fail;
+    apply->space_id = mach_read_4(frame->page + FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID);
+    return apply;
+
+fail:
+    apply_close(apply);
+    return NULL;
 }
 
-void show_log_header(const log_hdr* log_header) {
-    print_log(0, "============ LOG FILE HEADER ==============\n");
-    print_log(0, "log group id : %"PRIu32"\n", log_header->log_group_id);
-    print_log(0, "start lsn    : %"PRIu64"\n", log_header->start_lsn);
-    print_log(0, "end lsn      : %"PRIu64"\n", log_header->end_lsn);
-    print_log(0, "log file no  : %"PRIu32"\n", log_header->log_file_no);
-    print_log(0, "checkpoint1  : %"PRIu64"\n", log_header->checkpoint1);
-    print_log(0, "checkpoint2  : %"PRIu64"\n", log_header->checkpoint2);
+/* the bytes a record writes into its page: 0 for a record without a
+ * page, -1 for one the engine cannot apply */
+static ssize_t apply_len(const s_mtr_t* mtr) {
+    byte type = mtr->type & (byte)~MLOG_SINGLE_REC_FLAG;
+    switch (type) {
+        case MLOG_1BYTE:
+        case MLOG_2BYTES:
+        case MLOG_4BYTES:
+        case MLOG_8BYTES:
+            return type;
+        case MLOG_WRITE_STRING:
+            return mtr->data.len;
+        /* no page */
+        case MLOG_MULTI_REC_END:
+        case MLOG_DUMMY_RECORD:
+        case MLOG_CHECKPOINT:
+        case MLOG_FILE_CREATE:
+        case MLOG_FILE_RENAME:
+        case MLOG_FILE_DELETE:
+        case MLOG_FILE_CREATE2:
+        case MLOG_FILE_RENAME2:
+        case MLOG_FILE_NAME:
+            return 0;
+        default:
+            return -1;
+    }
 }
 
-void show_block_header(const block_hdr* block_header) {
-    print_log(0, "============== BLOCK HEADER ================\n");
-    print_log(0, "block no        : %"PRIu32"\n", block_header->block_no);
-    print_log(0, "block_data_len  : %"PRIu16"\n", block_header->block_data_len);
-    print_log(0, "first_rec_group : %"PRIu16"\n", block_header->first_rec_group);
-    print_log(0, "check_point_no  : %"PRIu32"\n", block_header->check_point_no);
-    print_log(0, "flush_bit       : %"PRIu8"\n" , block_header->flush_bit);
+/* write the records of a mini-transaction into the pages of the space.
+ * As in recv_recover_page, a page takes the whole mtr when its LSN, read
+ * before the mtr touches it, is older than the start of the mtr, and gets
+ * the end LSN once all its records are written. Only the MLOG_nBYTES and
+ * MLOG_WRITE_STRING records can be written: a page with any other record
+ * (or a write past its end) is poisoned first, see poison_page. 0 on an
+ * I/O error */
+int apply_mtr(apply_t* apply, const mtr_group_t* group) {
+    const s_mtr_t* mtr;
+    page_frame_t* frame;
+    ssize_t len;
+    size_t i, j, n_pages = 0;
+
+    for (i=0; i<group->n; ++i) {
+        mtr = &group->recs[i];
+        if (mtr->space_id != apply->space_id) continue;
+        len = apply_len(mtr);
+        if (len < 0) {
+            ++apply->stats.unsupported;
+            poison_page(apply, mtr->page_no);
+        } else if (len > 0 && (mtr->page_offset < 0
+                    || mtr->page_offset + len > UNIV_PAGE_SIZE)) {
+            ++apply->stats.bad;
+            poison_page(apply, mtr->page_no);
+        }
+    }
+
+    for (i=0; i<group->n; ++i) {
+        mtr = &group->recs[i];
+        if (mtr->space_id != apply->space_id) continue;
+        if ((len = apply_len(mtr)) <= 0) continue;
+        if (page_poisoned(apply, mtr->page_no)) {
+            ++apply->stats.held;
+            continue;
+        }
+        frame = get_frame(apply, mtr->page_no);
+        if (!frame) return 0;
+        if (page_poisoned(apply, mtr->page_no)) {
+            ++apply->stats.held;
+            continue;
+        }
+        /* the LSN is set after the mtr, so this is the page before it */
+        if (mach_read_8(frame->page + FIL_PAGE_LSN) >= group->start_lsn) {
+            ++apply->stats.skipped;
+            continue;
+        }
+        if ((mtr->type & (byte)~MLOG_SINGLE_REC_FLAG) == MLOG_WRITE_STRING)
+            memcpy(frame->page + mtr->page_offset, mtr->data.data, len);
+        else
+            write_be(frame->page + mtr->page_offset, mtr->value, len);
+        frame->dirty = 1;
+        ++apply->stats.applied;
+
+        for (j=0; j<n_pages && apply->mtr_pages[j] != mtr->page_no; ++j);
+        if (j < n_pages) continue;
+        if (n_pages == apply->mtr_pages_size) {
+            apply->mtr_pages_size = n_pages ? n_pages * 2 : 16;
+            apply->mtr_pages = realloc(apply->mtr_pages,
+                    apply->mtr_pages_size * sizeof(*apply->mtr_pages));
+            if (!apply->mtr_pages) {
+                perror("realloc");
+                exit(2);
+            }
+        }
+        apply->mtr_pages[n_pages++] = mtr->page_no;
+    }
+
+    /* the frame may have been written out meanwhile: get it again */
+    for (j=0; j<n_pages; ++j) {
+        frame = get_frame(apply, apply->mtr_pages[j]);
+        if (!frame) return 0;
+        write_be(frame->page + FIL_PAGE_LSN, group->end_lsn, 8);
+        frame->dirty = 1;
+    }
+    return 1;
+}
+
+static int cmp_frame_page_no(const void* a, const void* b) {
+    const page_frame_t *fa = *(page_frame_t* const*)a, *fb = *(page_frame_t* const*)b;
+    return fa->page_no < fb->page_no ? -1 : fa->page_no > fb->page_no;
+}
+
+/* the trailer LSN and the crc32 checksum, as buf_flush_init_for_writing
+ * writes them */
+static void stamp_page(byte* page) {
+    uint32_t checksum = crc32c(page + FIL_PAGE_OFFSET,
+            FIL_PAGE_FILE_FLUSH_LSN - FIL_PAGE_OFFSET)
+        ^ crc32c(page + FIL_PAGE_DATA,
+            UNIV_PAGE_SIZE - FIL_PAGE_DATA - FIL_PAGE_END_LSN_OLD_CHKSUM);
+    byte* trailer = page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM;
+    write_be(page + FIL_PAGE_SPACE_OR_CHKSUM, checksum, 4);
+    write_be(trailer, checksum, 4);
+    memcpy(trailer + 4, page + FIL_PAGE_LSN + 4, 4);
+}
+
+/* write out all dirty pages in page order, with one pwritev for each run
+ * of up to APPLY_WRITE_PAGES adjacent pages */
+int apply_flush(apply_t* apply) {
+    page_frame_t** dirty = malloc(apply->n_used * sizeof(*dirty));
+    struct iovec iov[APPLY_WRITE_PAGES];
+    size_t n = 0, i, j;
+    ssize_t ret;
+    int ok = 0;
+
+    if (!dirty) {
+        perror("malloc");
+        exit(2);
+    }
+    for (i=0; i<apply->n_used; ++i) {
+        if (!apply->frames[i].dirty) continue;
+        stamp_page(apply->frames[i].page);
+        dirty[n++] = &apply->frames[i];
+    }
+    qsort(dirty, n, sizeof(*dirty), cmp_frame_page_no);
+
+    for (i=0; i<n; i=j) {
+        for (j=i; j<n && j-i < APPLY_WRITE_PAGES
+                && dirty[j]->page_no == dirty[i]->page_no + (j - i); ++j) {
+            iov[j - i].iov_base = dirty[j]->page;
+            iov[j - i].iov_len = UNIV_PAGE_SIZE;
+        }
+        ret = pwritev(apply->fd, iov, j - i, (off_t)dirty[i]->page_no * UNIV_PAGE_SIZE);
+        ++apply->stats.syscalls;
+        if (ret != (ssize_t)(j - i) * UNIV_PAGE_SIZE) {
+            if (ret == -1) perror("pwritev");
+            else fprintf(stderr, "short write at page %"PRIu32"\n", dirty[i]->page_no);
+            goto done;
+        }
+        apply->stats.writes += j - i;
+        while (i < j) dirty[i++]->dirty = 0;
+    }
+    if (n) ++apply->stats.flushes;
+    ok = 1;
+
+done:
+    free(dirty);
+    return ok;
+}
+
+/* dirty pages are not written, see apply_flush */
+void apply_close(apply_t* apply) {
+    close(apply->fd);
+    free(apply->frames);
+    free(apply->pages);
+    free(apply->hash);
+    free(apply->poisoned);
+    free(apply->mtr_pages);
+    free(apply);
+}
+
+
+void show_log_header(reader_t* reader, const log_hdr* log_header) {
+    print_log(reader, 0, "============ LOG FILE HEADER ==============\n");
+    print_log(reader, 0, "log group id : %"PRIu32"\n", log_header->log_group_id);
+    print_log(reader, 0, "start lsn    : %"PRIu64"\n", log_header->start_lsn);
+    print_log(reader, 0, "end lsn      : %"PRIu64"\n", log_header->end_lsn);
+    print_log(reader, 0, "log file no  : %"PRIu32"\n", log_header->log_file_no);
+    print_log(reader, 0, "checkpoint1  : %"PRIu64"\n", log_header->checkpoint1);
+    print_log(reader, 0, "checkpoint2  : %"PRIu64"\n", log_header->checkpoint2);
+}
+
+void show_checkpoint(reader_t* reader, const checkpoint_t* checkpoint) {
+    print_log(reader, 0, "=============== CHECKPOINT =================\n");
+    print_log(reader, 0, "checkpoint no : %"PRIu64"\n", checkpoint->no);
+    print_log(reader, 0, "lsn           : %"PRIu64"\n", checkpoint->lsn);
+    print_log(reader, 0, "offset        : %lld\n", (long long)checkpoint->offset);
+    print_log(reader, 0, "log buf size  : %"PRIu32"\n", checkpoint->log_buf_size);
+    print_log(reader, 0, "archived lsn  : %"PRIu64"\n", checkpoint->archived_lsn);
+}
+
+void show_block_header(reader_t* reader, const block_hdr* block_header) {
+    print_log(reader, 0, "============== BLOCK HEADER ================\n");
+    print_log(reader, 0, "block no        : %"PRIu32"\n", block_header->block_no);
+    print_log(reader, 0, "block_data_len  : %"PRIu16"\n", block_header->block_data_len);
+    print_log(reader, 0, "first_rec_group : %"PRIu16"\n", block_header->first_rec_group);
+    print_log(reader, 0, "check_point_no  : %"PRIu32"\n", block_header->check_point_no);
+    print_log(reader, 0, "flush_bit       : %"PRIu8"\n" , block_header->flush_bit);
+}
+
+void show_io_stat(reader_t* reader) {
+    print_log(reader, 0, "records: %"PRIu64", blocks read: %"PRIu64
+            ", read syscalls: %"PRIu64"\n",
+            reader->records, reader->stats.blocks, reader->stats.syscalls);
+    if (reader->resyncs)
+        print_log(reader, 0, "unknown record types skipped: %"PRIu64"\n",
+                reader->resyncs);
+    if (reader->filtered)
+        print_log(reader, 0, "records filtered out: %"PRIu64"\n",
+                reader->filtered);
+}
+
+/* the ticks of each phase up to now: read and compact as measured, the
+ * rest split as in the samples, all of it output without any */
+void prof_estimate(const prof_t* prof, uint64_t now, uint64_t* ticks) {
+    uint64_t io = prof->ticks[PHASE_READ] + prof->ticks[PHASE_COMPACT];
+    uint64_t rest = now - prof->start_ticks - prof->idle;
+    uint64_t sampled = prof->ticks[PHASE_DECODE] + prof->ticks[PHASE_OUTPUT];
+    int i;
+
+    rest = rest > io ? rest - io : 0;
+    ticks[PHASE_READ] = prof->ticks[PHASE_READ];
+    ticks[PHASE_COMPACT] = prof->ticks[PHASE_COMPACT];
+    ticks[PHASE_DECODE] = sampled
+        ? (uint64_t)((double)rest * prof->ticks[PHASE_DECODE] / sampled) : 0;
+    ticks[PHASE_OUTPUT] = rest - ticks[PHASE_DECODE];
+    for (i=0; i<N_PHASES; ++i) ticks[i] += prof->merged[i];
+}
+
+/* the counters, and with --profile the time of each phase up to now; a
+ * signal handler may ask for it in the middle of a run, so it goes to its
+ * own stream and does not touch the reader */
+void show_prof_stat(const reader_t* reader, FILE* out) {
+    static const char* phase_names[N_PHASES] = { "decode", "read", "compact", "output" };
+    const prof_t* prof = &reader->prof;
+    uint64_t ticks[N_PHASES], total = 0, now = prof_ticks();
+    struct timespec ts;
+    double wall, tick_seconds;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    wall = ts.tv_sec - prof->start.tv_sec + (ts.tv_nsec - prof->start.tv_nsec) / 1e9;
+    fprintf(out, "read: %"PRIu64" bytes, %"PRIu64" syscalls, %"PRIu64" blocks, "
+            "%"PRIu64" refills, %"PRIu64" bytes compacted\n",
+            reader->stats.bytes, reader->stats.syscalls, reader->stats.blocks,
+            reader->stats.refills, reader->stats.compacted);
+    fprintf(out, "records: %"PRIu64", filtered out: %"PRIu64
+            ", unknown types skipped: %"PRIu64"\n",
+            reader->records, reader->filtered, reader->resyncs);
+    for (i=0; i<=MLOG_BIGGEST_TYPE; ++i)
+        if (reader->type_records[i])
+            fprintf(out, "  %-36s %"PRIu64"\n", log_type_name(i),
+                    reader->type_records[i]);
+    if (!reader->opt.profile) {
+        fprintf(out, "wall: %.3fs\n", wall);
+        return;
+    }
+
+    prof_estimate(prof, now, ticks);
+    for (i=0; i<N_PHASES; ++i) total += ticks[i];
+    tick_seconds = now > prof->start_ticks ? wall / (now - prof->start_ticks) : 0;
+    /* with --threads the phases add up the time of all threads */
+    fprintf(out, "wall: %.3fs, phases: %.3fs\n", wall, total * tick_seconds);
+    for (i=0; i<N_PHASES; ++i)
+        fprintf(out, "  %-8s %10.3fs %6.1f%%\n", phase_names[i],
+                ticks[i] * tick_seconds, total ? 100.0 * ticks[i] / total : 0.0);
+}
+
+/* by bytes, then by type: the entries are in type order */
+static int cmp_type_bytes(const void* a, const void* b) {
+    const type_stat_t *ta = *(type_stat_t* const*)a, *tb = *(type_stat_t* const*)b;
+    if (ta->bytes != tb->bytes) return ta->bytes < tb->bytes ? 1 : -1;
+    return ta < tb ? -1 : ta > tb;
+}
+
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0;
+}
+
+static void show_mtr_stat(reader_t* reader, const char* name, const mtr_stat_t* mtr_stat) {
+    int i;
+    print_log(reader, 0, "%s mtrs: %"PRIu64", records: %"PRIu64", bytes: %"PRIu64
+            ", avg bytes: %.1f, max bytes: %"PRIu64"\n", name,
+            mtr_stat->count, mtr_stat->records, mtr_stat->bytes,
+            mtr_stat->count ? (double)mtr_stat->bytes / mtr_stat->count : 0,
+            mtr_stat->max_bytes);
+    for (i=0; i<MTR_SIZE_BUCKETS; ++i)
+        if (mtr_stat->sizes[i])
+            print_log(reader, 0, " %8"PRIu64"%s bytes: %"PRIu64" (%.2f%%)\n",
+                    (uint64_t)1 << i, i == MTR_SIZE_BUCKETS - 1 ? "+" : " ",
+                    mtr_stat->sizes[i], percent(mtr_stat->sizes[i], mtr_stat->count));
 }
 
-void show_mtr(const s_mtr_t* mtr) {
-    print_log(0, "MTR: type(%s, %s) space_id(%"PRIu32") page_no(%"PRIu32")\n",
+/* the types by bytes, most first, and the mini-transaction sizes in
+ * power of 2 buckets */
+void show_log_stat(reader_t* reader, const log_stat_t* stat) {
+    const type_stat_t* order[MLOG_BIGGEST_TYPE + 1];
+    const type_stat_t* type_stat;
+    int i, n = 0;
+
+    for (i=0; i<=MLOG_BIGGEST_TYPE; ++i)
+        if (stat->types[i].records) order[n++] = &stat->types[i];
+    qsort(order, n, sizeof(*order), cmp_type_bytes);
+
+    print_log(reader, 0, "============== REDO VOLUME ================\n");
+    print_log(reader, 0, "%-36s %10s %7s %12s %7s %8s\n",
+            "type", "records", "%", "bytes", "%", "avg");
+    for (i=0; i<n; ++i) {
+        type_stat = order[i];
+        print_log(reader, 0, "%-36s %10"PRIu64" %6.2f%% %12"PRIu64" %6.2f%% %8.1f\n",
+                log_type_name(type_stat - stat->types), type_stat->records,
+                percent(type_stat->records, stat->records), type_stat->bytes,
+                percent(type_stat->bytes, stat->bytes),
+                (double)type_stat->bytes / type_stat->records);
+    }
+    print_log(reader, 0, "%-36s %10"PRIu64" %7s %12"PRIu64"\n",
+            "total", stat->records, "", stat->bytes);
+    show_mtr_stat(reader, "single-record", &stat->single);
+    show_mtr_stat(reader, "multi-record", &stat->multi);
+}
+
+void show_apply_stat(reader_t* reader, const apply_t* apply) {
+    const apply_stat_t* stat = &apply->stats;
+    print_log(reader, 0, "apply: space_id(%"PRIu32") records applied: %"PRIu64
+            ", skipped: %"PRIu64", not supported: %"PRIu64", bad: %"PRIu64"\n",
+            apply->space_id, stat->applied, stat->skipped, stat->unsupported, stat->bad);
+    if (stat->poisoned)
+        print_log(reader, 0, "pages left alone: %"PRIu64" (records not applied: %"PRIu64
+                "), not complete: a record of theirs is not supported, or they"
+                " are past the end of the file\n", stat->poisoned, stat->held);
+    print_log(reader, 0, "pages read: %"PRIu64", written: %"PRIu64" in %"PRIu64
+            " flushes, syscalls: %"PRIu64"\n",
+            stat->reads, stat->writes, stat->flushes, stat->syscalls);
+}
+
+void show_mtr_group(reader_t* reader, const mtr_group_t* group) {
+    size_t i;
+    print_log(reader, 0, "MTR GROUP: lsn %"PRIu64" - %"PRIu64", records: %lu, bytes: %"PRIu64"\n",
+            group->start_lsn, group->end_lsn, (unsigned long)group->n, group->bytes);
+    for (i=0; i<group->n; ++i) show_mtr(reader, &group->recs[i]);
+}
+
+/* a page of the page index with the record count of each type */
+void show_page_stat(reader_t* reader, const page_stat_t* page) {
+    uint64_t counts[MLOG_BIGGEST_TYPE + 1];
+    const page_chunk_t* chunk;
+    int i;
+
+    memset(counts, 0, sizeof(counts));
+    for (chunk = page->chunks; chunk; chunk = chunk->next)
+        for (i=0; i<chunk->n; ++i)
+            if (chunk->type[i] <= MLOG_BIGGEST_TYPE) ++counts[chunk->type[i]];
+
+    print_log(reader, 0, "space_id(%"PRIu32") page_no(%"PRIu32") records: %"PRIu64
+            ", bytes: %"PRIu64", lsn: %"PRIu64" - %"PRIu64"\n",
+            page->space_id, page->page_no, page->records, page->bytes,
+            page->min_lsn, page->max_lsn);
+    for (i=0; i<=MLOG_BIGGEST_TYPE; ++i)
+        if (counts[i])
+            print_log(reader, 0, " %s: %"PRIu64"\n", log_type_name(i), counts[i]);
+}
+
+/* a batch of the apply plan: the records of one page in LSN order */
+void show_page_recs(reader_t* reader, const page_stat_t* page) {
+    const recv_t* recv;
+    reader->log_indent = 0;
+    print_log(reader, 0, "PAGE: space_id(%"PRIu32") page_no(%"PRIu32") records: %"PRIu64
+            ", lsn: %"PRIu64" - %"PRIu64"\n",
+            page->space_id, page->page_no, page->records, page->min_lsn, page->max_lsn);
+    for (recv = page->recs; recv; recv = recv->next) show_mtr(reader, &recv->mtr);
+}
+
+/* text output of a record; the records of a multi-record mtr are
+ * indented */
+void show_mtr(reader_t* reader, const s_mtr_t* mtr) {
+    byte type = mtr->type & (byte)~MLOG_SINGLE_REC_FLAG;
+    const mtr_update_t* upd = &mtr->update;
+
+    reader->log_indent = !mtr_is_single_rec(mtr)
+        && type != MLOG_MULTI_REC_END && type != MLOG_DUMMY_RECORD
+        && type != MLOG_CHECKPOINT;
+    print_log(reader, 0, "MTR: type(%s, %s) space_id(%"PRIu32") page_no(%"PRIu32")\n",
             mtr_type_name(mtr),
             mtr_is_single_rec(mtr) ? "single" : "multi",
             mtr->space_id, mtr->page_no);
-}
 
-void hexdump(const byte* ptr, ssize_t len) {
-    ssize_t k, i, j = HEXDUMP_COLUMN_LEN;
-    char str[HEXDUMP_COLUMN_LEN + 1];
-    uint8_t snip = len > 256 ? 1 : 0;
-    if (len > 256) len = 256;
-#if 0
-    wchar_t w_str[HEXDUMP_COLUMN_LEN + 1];
-#endif
-    for (i=0; i<j; ++i) {
-        printf("%02x%s", i<len ? 0xFF & ((char*)ptr)[i] : '\0', i&1?" ":"");
-        if ((i+1)%HEXDUMP_COLUMN_LEN == 0) {
-            memset(str, 0, HEXDUMP_COLUMN_LEN + 1);
-            memcpy(
-              str, ptr + (i/HEXDUMP_COLUMN_LEN) * HEXDUMP_COLUMN_LEN,
-              i < len ? HEXDUMP_COLUMN_LEN : len + HEXDUMP_COLUMN_LEN - j
-            );
-            if (j < len) j += HEXDUMP_COLUMN_LEN;
-#if 0
-            swprintf(w_str, sizeof(w_str)/sizeof(*w_str), L"%s", str);
-            wprintf(L": %ls\n", w_str);
-#endif
-            k = 0;
-            while (k < HEXDUMP_COLUMN_LEN) {
-                putchar(isprint(str[k]) ? str[k] : '.');
-                ++k;
+    switch (type) {
+        case MLOG_1BYTE:
+        case MLOG_2BYTES:
+        case MLOG_4BYTES:
+        case MLOG_8BYTES:
+            print_log(reader, 0, "page offset: %"PRId32" ", mtr->page_offset);
+            print_log(reader, 0, "value: %"PRIu64"\n", mtr->value);
+            break;
+        case MLOG_REC_INSERT:
+        case MLOG_COMP_REC_INSERT:
+            show_index(reader, mtr);
+            print_log(reader, 0, "page offset: %"PRId32"\n", mtr->page_offset);
+            show_insert_rec(reader, &mtr->insert);
+            break;
+        case MLOG_LIST_END_COPY_CREATED:
+        case MLOG_COMP_LIST_END_COPY_CREATED: {
+            mtr_insert_t rec;
+            const byte* data;
+            size_t pos = 0, len;
+            show_index(reader, mtr);
+            print_log(reader, 0, "data_len: %zu\n", mtr->data.len);
+            data = view_bytes(reader, &mtr->data);
+            while (pos < mtr->data.len) {
+                len = decode_insert_rec(data + pos, data + mtr->data.len, &rec);
+                if (!len) break;
+                show_insert_rec(reader, &rec);
+                pos += len;
+            }
+            break;
+        }
+        case MLOG_LIST_END_DELETE:
+        case MLOG_COMP_LIST_END_DELETE:
+        case MLOG_LIST_START_DELETE:
+        case MLOG_COMP_LIST_START_DELETE:
+        case MLOG_REC_DELETE:
+        case MLOG_COMP_REC_DELETE:
+            show_index(reader, mtr);
+            print_log(reader, 0, "page offset: %"PRId32"\n", mtr->page_offset);
+            break;
+        case MLOG_PAGE_REORGANIZE:
+        case MLOG_COMP_PAGE_REORGANIZE:
+            show_index(reader, mtr);
+            break;
+        case MLOG_UNDO_INSERT:
+            print_log(reader, 0, "length: %zu\n", mtr->data.len);
+            hexdump_view(reader, &mtr->data);
+            break;
+        case MLOG_REC_UPDATE_IN_PLACE:
+        case MLOG_COMP_REC_UPDATE_IN_PLACE: {
+            const byte *ptr, *end;
+            uint32_t i, field_no, len;
+            ssize_t n;
+            show_index(reader, mtr);
+            ptr = view_bytes(reader, &upd->fields);
+            end = ptr + upd->fields.len;
+            print_log(reader, 0, "flags: %"PRIu8"\n", upd->flags);
+            show_trx_id(reader, upd);
+            print_log(reader, 0, "page offset: %"PRId32"\n", mtr->page_offset);
+            print_log(reader, 0, "info_bits: %"PRIu8", n_fields: %"PRIu32"\n",
+                    upd->info_bits, upd->n_fields);
+            for (i=0; i<upd->n_fields; ++i) {
+                if (!(n = mach_parse_compressed(&field_no, ptr, end))) break;
+                ptr += n;
+                if (!(n = mach_parse_compressed(&len, ptr, end))) break;
+                ptr += n;
+                if (len > (size_t)(end - ptr)) break;
+                print_log(reader, 0, "field_no: %"PRIu32", len: %"PRIu32"\n", field_no, len);
+                if (len > 0) hexdump(reader, ptr, len);
+                ptr += len;
             }
-            printf("\n");
+            break;
+        }
+        case MLOG_COMP_REC_SEC_DELETE_MARK:
+            show_index(reader, mtr);
+            /* fall through */
+        case MLOG_REC_SEC_DELETE_MARK:
+            print_log(reader, 0, "val: %"PRIu64", page offset: %"PRId32"\n",
+                    mtr->value, mtr->page_offset);
+            break;
+        case MLOG_REC_CLUST_DELETE_MARK:
+        case MLOG_COMP_REC_CLUST_DELETE_MARK:
+            show_index(reader, mtr);
+            print_log(reader, 0, "flags: %"PRIu8", val: %"PRIu8"\n", upd->flags, upd->val);
+            show_trx_id(reader, upd);
+            print_log(reader, 0, "page offset: %"PRId32"\n", mtr->page_offset);
+            break;
+        case MLOG_WRITE_STRING:
+            print_log(reader, 0, "page offset: %"PRId32", len: %zu\n",
+                    mtr->page_offset, mtr->data.len);
+            hexdump_view(reader, &mtr->data);
+            break;
+        case MLOG_UNDO_INIT:
+            print_log(reader, 0, "undo log segment type: %"PRIu64"\n", mtr->value);
+            break;
+        case MLOG_UNDO_HDR_CREATE:
+        case MLOG_UNDO_HDR_REUSE:
+            print_log(reader, 0, "TRX_ID: %"PRIu64"\n", mtr->value);
+            break;
+        case MLOG_FILE_CREATE2:
+            print_log(reader, 0, "flags: 0x%"PRIx64"\n", mtr->value);
+            /* fall through */
+        case MLOG_FILE_CREATE:
+        case MLOG_FILE_DELETE:
+        case MLOG_FILE_NAME:
+            print_log(reader, 0, "filename: %.*s\n",
+                    (int)mtr->data.len, view_bytes(reader, &mtr->data));
+            break;
+        case MLOG_FILE_RENAME:
+        case MLOG_FILE_RENAME2:
+            print_log(reader, 0, "old filename: %.*s\n",
+                    (int)mtr->data.len, view_bytes(reader, &mtr->data));
+            print_log(reader, 0, "new filename: %.*s\n",
+                    (int)mtr->data2.len, view_bytes(reader, &mtr->data2));
+            break;
+        case MLOG_REC_MIN_MARK:
+        case MLOG_COMP_REC_MIN_MARK:
+            print_log(reader, 0, "page offset: %"PRId32"\n", mtr->page_offset);
+            break;
+        case MLOG_ZIP_WRITE_NODE_PTR:
+        case MLOG_ZIP_WRITE_BLOB_PTR:
+            print_log(reader, 0, "page offset: %"PRId32", compressed offset: %"PRIu64"\n",
+                    mtr->page_offset, mtr->value);
+            hexdump_view(reader, &mtr->data);
+            break;
+        case MLOG_ZIP_WRITE_HEADER:
+            print_log(reader, 0, "page offset: %"PRId32", len: %zu\n",
+                    mtr->page_offset, mtr->data.len);
+            hexdump_view(reader, &mtr->data);
+            break;
+        case MLOG_ZIP_PAGE_COMPRESS:
+            print_log(reader, 0, "compressed size: %"PRIu64", trailer size: %"PRIu64"\n",
+                    mtr->data.len - 8 - mtr->value, mtr->value);
+            hexdump_view(reader, &mtr->data);
+            break;
+        case MLOG_ZIP_PAGE_COMPRESS_NO_DATA:
+        case MLOG_ZIP_PAGE_REORGANIZE:
+            show_index(reader, mtr);
+            print_log(reader, 0, "compression level: %"PRIu64"\n", mtr->value);
+            break;
+        case MLOG_CHECKPOINT:
+            print_log(reader, 0, "checkpoint lsn: %"PRIu64"\n", mtr->value);
+            break;
+    }
+}
+
+void show_index(reader_t* reader, const s_mtr_t* mtr) {
+    const mtr_index_t* index = &mtr->index;
+    const byte* fields = view_bytes(reader, &index->fields);
+    uint16_t i, column_len;
+    print_log(reader, 0, "number of columns in index: %"PRIu16"\n"
+           "number of columns in unique index: %"PRIu16"\n",
+           index->n_fields, index->n_uniq);
+    for (i=0; i<index->fields.len / 2; ++i) {
+        column_len = mach_read_2(fields + i * 2);
+        /* The high-order bit of len is the NOT NULL flag;
+         * the rest is 0 or 0x7fff for variable-length fields,
+         * 1..0x7ffe for fixed-length fields. */
+        print_log(reader, 0, "%"PRIu16" column in index", i);
+        print_log(reader, 0, " > nullable: %s",
+                column_len & 0x8000 ? "no" : "yes");
+        print_log(reader, 0, " > fixed/variable len: %s\n",
+                ((column_len + 1) & 0x7fff) <= 1 ?
+                "variable" : "fixed");
+    }
+}
+
+void show_insert_rec(reader_t* reader, const mtr_insert_t* rec) {
+    if (rec->has_origin)
+        print_log(reader, 0, "origin  offset: %"PRIu32"\n"
+               "mismatch index: %"PRIu32"\n",
+               rec->origin_offset, rec->mismatch_index);
+    print_log(reader, 0, "end seg len: %zu\n", rec->end_seg.len);
+    if (rec->end_seg.len > 0) hexdump_view(reader, &rec->end_seg);
+}
+
+void show_trx_id(reader_t* reader, const mtr_update_t* upd) {
+    print_log(reader, 0, "TRX_ID position in record: %"PRIx32", roll ptr: 0x%"PRIx64"\n"
+           "TRX_ID: 0x%016"PRIx64"\n",
+           upd->trx_id_pos, upd->roll_ptr, upd->trx_id);
+}
+
+/* 16 bytes per row: hex words, then the printable characters; rows are
+ * rendered into one buffer and written with a single call */
+static void hexdump_rows(reader_t* reader, const byte* ptr, ssize_t len, int snip) {
+    static const char hex[] = "0123456789abcdef";
+    char rows[HEXDUMP_BATCH_ROWS * HEXDUMP_ROW_LEN + sizeof(HEXDUMP_SNIP)];
+    char* dst = rows;
+    ssize_t row = 0, i, n;
+    byte c;
+    FILE* out = reader->opt.out;
+
+    do {
+        n = len - row < HEXDUMP_COLUMN_LEN ? len - row : HEXDUMP_COLUMN_LEN;
+        for (i=0; i<HEXDUMP_COLUMN_LEN; ++i) {
+            c = i < n ? ptr[row + i] : 0;
+            *dst++ = hex[c >> 4];
+            *dst++ = hex[c & 0xF];
+            if (i & 1) *dst++ = ' ';
+        }
+        for (i=0; i<HEXDUMP_COLUMN_LEN; ++i) {
+            c = i < n ? ptr[row + i] : 0;
+            *dst++ = c >= 0x20 && c < 0x7F ? c : '.';
+        }
+        *dst++ = '\n';
+        row += HEXDUMP_COLUMN_LEN;
+
+        if (dst == rows + HEXDUMP_BATCH_ROWS * HEXDUMP_ROW_LEN) {
+            fwrite(rows, 1, dst - rows, out);
+            dst = rows;
+        }
+    } while (row < len);
+    if (snip) {
+        memcpy(dst, HEXDUMP_SNIP, sizeof(HEXDUMP_SNIP) - 1);
+        dst += sizeof(HEXDUMP_SNIP) - 1;
+    }
+    fwrite(rows, 1, dst - rows, out);
+}
+
+void hexdump(reader_t* reader, const byte* ptr, ssize_t len) {
+    if (reader->opt.log_level < 0) return;
+    if (len > HEXDUMP_MAX_LEN && !reader->opt.hexdump_full)
+        hexdump_rows(reader, ptr, HEXDUMP_MAX_LEN, 1);
+    else
+        hexdump_rows(reader, ptr, len, 0);
+}
+
+/* hexdump of a view that may not be in memory: its segments are gathered
+ * into batches of rows */
+void hexdump_view(reader_t* reader, const view_t* view) {
+    byte batch[HEXDUMP_BATCH_ROWS * HEXDUMP_COLUMN_LEN];
+    payload_cursor_t cursor;
+    const byte* data;
+    size_t len = view->len, fill = 0, n, take;
+
+    if (view->data || !view->len) {
+        hexdump(reader, view->data, view->len);
+        return;
+    }
+    if (reader->opt.log_level < 0) return;
+    if (len > HEXDUMP_MAX_LEN && !reader->opt.hexdump_full) len = HEXDUMP_MAX_LEN;
+    payload_open(&cursor, reader, view);
+    cursor.left = len;
+    while ((n = payload_next(&cursor, &data))) {
+        for (; n; n -= take, data += take) {
+            take = n < sizeof(batch) - fill ? n : sizeof(batch) - fill;
+            memcpy(batch + fill, data, take);
+            fill += take;
+            if (fill < sizeof(batch)) continue;
+            hexdump_rows(reader, batch, fill, 0);
+            fill = 0;
         }
     }
-    if (snip) printf("... snip ...\n");
+    if (fill) hexdump_rows(reader, batch, fill, len < view->len);
 }
 
-void print_log(const int level, const char *format, ...) {
-    if (level > log_level) return;
+void log_printf(reader_t* reader, const char *format, ...) {
+    FILE* out = reader->opt.out;
     int i;
-    for (i=0;i<log_indent;++i) printf(" ");
+    for (i=0;i<reader->log_indent;++i) fputc(' ', out);
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    vfprintf(out, format, args);
     va_end(args);
 }
@@ -1,17 +1,90 @@
 #ifndef redo_log_reader_h
 #define redo_log_reader_h
 
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <aio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
 #include "mysql_simple.h"
 
-#define MEMORY_BUFFER_SIZE (OS_FILE_LOG_BLOCK_SIZE*128)
+/* default size, see --buffer-size */
+#define MEMORY_BUFFER_SIZE (OS_FILE_LOG_BLOCK_SIZE*4096)
+#define MIN_MEMORY_BUFFER_SIZE (OS_FILE_LOG_BLOCK_SIZE*4)
 #define HEXDUMP_COLUMN_LEN 16
+#define HEXDUMP_ROW_LEN (HEXDUMP_COLUMN_LEN / 2 * 5 + HEXDUMP_COLUMN_LEN + 1)
+#define HEXDUMP_BATCH_ROWS 64
+#define HEXDUMP_MAX_LEN 256 /* unless --full-dump */
+#define HEXDUMP_SNIP "... snip ...\n"
 
 #define BYTE_N(n) (8*(n))
 #define READ_N(dst,src,n) { \
     dst=0; uint64_t i; \
     for (i=0; i<n; ++i) dst |= (((uint64_t)(*(src+i)))<<BYTE_N(n-i-1));\
 }
-#define READ(dst,src) READ_N(dst,src,sizeof(dst))
+
+/* big-endian loads of 1, 2, 4 and 8 bytes: one unaligned load and a byte
+ * swap each */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BSWAP_16(x) (x)
+#define BSWAP_32(x) (x)
+#define BSWAP_64(x) (x)
+#else
+#define BSWAP_16(x) __builtin_bswap16(x)
+#define BSWAP_32(x) __builtin_bswap32(x)
+#define BSWAP_64(x) __builtin_bswap64(x)
+#endif
+
+static inline uint16_t mach_read_2(const byte* src) {
+    uint16_t val;
+    memcpy(&val, src, sizeof(val));
+    return BSWAP_16(val);
+}
+
+static inline uint32_t mach_read_4(const byte* src) {
+    uint32_t val;
+    memcpy(&val, src, sizeof(val));
+    return BSWAP_32(val);
+}
+
+static inline uint64_t mach_read_8(const byte* src) {
+    uint64_t val;
+    memcpy(&val, src, sizeof(val));
+    return BSWAP_64(val);
+}
+
+/* the width follows the destination type and is folded at compile time */
+#define READ(dst,src) ((dst) = \
+    sizeof(dst) == 1 ? *(const byte*)(src) : \
+    sizeof(dst) == 2 ? mach_read_2(src) : \
+    sizeof(dst) == 4 ? mach_read_4(src) : \
+    mach_read_8(src))
+
+/* mach_parse_compressed: the high bits of the first byte give the length,
+ * see the table; returns the number of bytes used, 0 if they do not all
+ * come before end. Only those bytes are loaded */
+static const uint8_t compressed_len[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4, 5
+};
+
+static inline ssize_t mach_parse_compressed(uint32_t* dst, const byte* src,
+        const byte* end) {
+    ssize_t len;
+    if (src >= end) return 0;
+    len = compressed_len[*src >> 4];
+    if (end - src < len) return 0;
+    switch (len) {
+        case 1: *dst = *src; break;
+        case 2: *dst = mach_read_2(src) & 0x7FFFUL; break;
+        case 3: *dst = ((uint32_t)*src << 16 | mach_read_2(src + 1)) & 0x3FFFFFUL; break;
+        case 4: *dst = mach_read_4(src) & 0x1FFFFFFFUL; break;
+        default: *dst = mach_read_4(src + 1); break;
+    }
+    return len;
+}
 
 typedef struct log_hdr {
     /* first block */
@@ -26,6 +99,15 @@ typedef struct log_hdr {
     uint64_t checkpoint2;
 } log_hdr;
 
+/* a checkpoint field of the first file of a log group */
+typedef struct checkpoint_t {
+    uint64_t no;
+    uint64_t lsn;
+    off_t offset;           /* of lsn in the group, file headers included */
+    uint32_t log_buf_size;
+    uint64_t archived_lsn;
+} checkpoint_t;
+
 typedef struct block_hdr {
     uint32_t block_no;
     uint16_t block_data_len;
@@ -34,56 +116,601 @@ typedef struct block_hdr {
     uint8_t  flush_bit;
 } block_hdr;
 
+/* bytes of a record body: they point into the read buffer or the mapped
+ * file, and stay valid until the next reader_next_record call. data is
+ * NULL when the body was too large to be kept in the buffer; read it then
+ * with a payload_cursor_t */
+typedef struct view_t {
+    const byte* data;
+    size_t   len;
+    off_t    offset;        /* file offset of the first byte */
+} view_t;
+
+/* the index written by mlog_open_and_write_index */
+typedef struct mtr_index_t {
+    uint16_t n_fields;
+    uint16_t n_uniq;
+    view_t   fields;        /* compact format: 2 bytes per field */
+} mtr_index_t;
+
+/* page_cur_parse_insert_rec */
+typedef struct mtr_insert_t {
+    uint8_t  has_origin;    /* the three fields below are present */
+    uint8_t  info_status_bits;
+    uint32_t origin_offset;
+    uint32_t mismatch_index;
+    view_t   end_seg;
+} mtr_insert_t;
+
+/* update in place and clustered delete mark */
+typedef struct mtr_update_t {
+    uint8_t  flags;
+    uint8_t  val;           /* delete mark */
+    uint8_t  info_bits;
+    uint32_t trx_id_pos;
+    uint64_t roll_ptr;
+    uint64_t trx_id;
+    uint32_t n_fields;
+    view_t   fields;        /* n_fields x (field_no, len, data) */
+} mtr_update_t;
+
 typedef struct simple_mtr_t {
     uint8_t  type;
     uint32_t space_id;
     uint32_t page_no;
+    int32_t  page_offset;   /* -1 if the record has none */
+    uint64_t lsn;
+    off_t    offset;        /* file offset of the type byte */
+    view_t   payload;       /* the body after space_id and page_no */
+    size_t   len;           /* of the whole record, block headers excluded */
+
+    /* type specific, see show_mtr */
+    uint64_t value;         /* MLOG_nBYTES, undo segment type, undo TRX_ID or
+                               secondary delete mark */
+    mtr_index_t index;
+    mtr_insert_t insert;
+    mtr_update_t update;
+    view_t   data;          /* string, undo record, list end records or
+                               file name */
+    view_t   data2;         /* new name of MLOG_FILE_RENAME */
 } s_mtr_t;
 
+/* reads a view from the log in segments, each in place: in memory, in the
+ * mapping or in the chunk of blocks the cursor read, so its memory does
+ * not grow with the length; see payload_next */
+#define PAYLOAD_CHUNK_SIZE (OS_FILE_LOG_BLOCK_SIZE*16)
+typedef struct payload_cursor_t {
+    struct reader_t* reader;
+    const byte* data;       /* the view when it is in memory */
+    off_t offset;           /* file offset of the next byte */
+    size_t left;
+    off_t chunk_offset;     /* file offset of the first block in chunk */
+    ssize_t chunk_len;
+    byte chunk[PAYLOAD_CHUNK_SIZE];
+} payload_cursor_t;
+
 typedef struct buffer_t {
-    byte buffer[MEMORY_BUFFER_SIZE];
+    byte* memory;
+    ssize_t memory_size;
+    /* points to memory, or into the mapped log file (mmap mode) */
+    byte* buffer;
     off_t buffer_offset;
     off_t start_buffer_offset;
     off_t start_file_offset;
+    uint64_t start_lsn;     /* LSN of the block at start_file_offset */
     ssize_t buffer_len;
+    off_t mark;             /* kept by refills (the body of the record being
+                               parsed), -1: none */
+    int at_group;           /* nothing parsed since the open or a seek to a
+                               block: skip to the first record group */
 } buf_t;
 
-void hexdump(const byte*, ssize_t);
+/* read-ahead ring: depth chunks in flight ahead of the parser */
+typedef struct prefetch_t {
+    struct aiocb* cbs;
+    byte* memory;
+    int depth;
+    int head;               /* slot of the chunk being consumed */
+    ssize_t chunk_size;
+    ssize_t chunk_len;      /* -1 until the head read is collected */
+    ssize_t chunk_pos;
+    off_t next_offset;      /* file offset of the next read to submit */
+} prefetch_t;
+
+typedef struct io_stat {
+    uint64_t blocks;
+    uint64_t syscalls;
+    uint64_t bytes;         /* read, or blocks parsed in the mapping */
+    uint64_t refills;
+    uint64_t compacted;     /* unread bytes moved to the front by refills,
+                               or copied out of the mapping with --mmap */
+} io_stat;
+
+/* --profile: the time of a reader by phase, sampled to cost little. The
+ * clock is read around the reads and the compaction of each refill, and
+ * for one record (or mtr) in PROF_SAMPLE around its decoding and around
+ * what the caller does with it up to the next call (output). The rest of
+ * the time is split between decode and output as in the samples, see
+ * prof_estimate. Ticks are TSC cycles on x86-64, nanoseconds elsewhere */
+#define PROF_SAMPLE 64
+enum prof_phase_t { PHASE_DECODE, PHASE_READ, PHASE_COMPACT, PHASE_OUTPUT, N_PHASES };
+
+typedef struct prof_t {
+    uint64_t calls;
+    int sample_phase;
+    uint64_t sample_start;  /* ticks when the sample began, 0: none running */
+    uint64_t sample_io;     /* read and compact ticks then */
+    uint64_t ticks[N_PHASES];   /* read, compact: all; decode, output: samples */
+    uint64_t merged[N_PHASES];  /* estimates of other readers, see --threads */
+    uint64_t idle;          /* ticks of no phase: waiting for those readers */
+    uint64_t start_ticks;
+    struct timespec start;  /* with start_ticks, the length of a tick */
+} prof_t;
+
+/* block checksums accepted by verify_blocks */
+enum checksum_t { CHECKSUM_ANY, CHECKSUM_CRC32, CHECKSUM_INNODB };
+
+typedef struct verify_stat {
+    uint64_t blocks;
+    uint64_t bad;
+    uint64_t empty;         /* never written: block number 0 */
+    uint64_t syscalls;
+    int first_bad_file;     /* -1: no bad block */
+    off_t first_bad_offset;
+    uint32_t first_bad_no;
+} verify_stat;
+
+/* growable output buffer */
+typedef struct out_buf_t {
+    byte* data;
+    size_t len;
+    size_t size;
+} out_buf_t;
+
+enum output_format_t { OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_BINARY };
+#define OUTPUT_FLUSH_SIZE (1 << 20)
+/* binary record: u32 length of the rest, u8 type, u8 single, u16 page
+ * offset (0xFFFF: none), u32 space_id, u32 page_no, u64 lsn, u64 file
+ * offset, u32 payload length, payload; all big-endian */
+#define BINARY_RECORD_HDR_SIZE 36
+
+/* block index sidecar: u32 INDEX_MAGIC, u32 interval, then one entry per
+ * record group start: u64 lsn, u64 file offset (an LSN in group mode), u32
+ * block_no, u32 check_point_no, u16 first_rec_group; all big-endian */
+#define INDEX_MAGIC 0x524c5249  /* "RLRI" */
+#define INDEX_HDR_SIZE 8
+#define INDEX_ENTRY_SIZE 26
+#define INDEX_INTERVAL 64
+
+typedef struct index_entry_t {
+    uint64_t lsn;           /* of the first record group in the block */
+    off_t offset;           /* of that record group */
+    uint32_t block_no;
+    uint32_t check_point_no;
+    uint16_t first_rec_group;
+} index_entry_t;
+
+typedef struct block_index_t {
+    index_entry_t* entries;     /* in file order */
+    size_t n;
+    size_t size;
+    int interval;           /* blocks between entries, at least */
+    off_t next_offset;      /* while building */
+} block_index_t;
+
+/* the records of one mini-transaction: a record with MLOG_SINGLE_REC_FLAG,
+ * or the records up to and including MLOG_MULTI_REC_END. The record
+ * vector and the payload copies are reused from one mtr to the next */
+typedef struct mtr_group_t {
+    s_mtr_t* recs;
+    size_t n;
+    size_t size;
+    out_buf_t payloads;     /* the views of recs point in here */
+    uint64_t start_lsn;
+    uint64_t end_lsn;       /* after the last record */
+    uint64_t bytes;         /* block headers excluded */
+} mtr_group_t;
+
+/* redo volume by record type and by mini-transaction */
+#define MTR_SIZE_BUCKETS 20     /* powers of 2, the last one open */
+typedef struct type_stat_t {
+    uint64_t records;
+    uint64_t bytes;
+} type_stat_t;
+
+typedef struct mtr_stat_t {
+    uint64_t count;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t max_bytes;
+    uint64_t sizes[MTR_SIZE_BUCKETS];   /* by bytes */
+} mtr_stat_t;
+
+typedef struct log_stat_t {
+    uint64_t records;
+    uint64_t bytes;
+    type_stat_t types[MLOG_BIGGEST_TYPE + 1];
+    mtr_stat_t single;
+    mtr_stat_t multi;
+    uint64_t open_records;  /* of the mtr not ended yet */
+    uint64_t open_bytes;
+} log_stat_t;
+
+/* arena: records are never freed one by one */
+#define ARENA_BLOCK_SIZE (4 << 20)
+typedef struct arena_t {
+    byte* block;            /* newest, chained through its first word */
+    size_t used;
+    size_t size;
+    size_t total;           /* of all blocks */
+} arena_t;
+
+/* per-page aggregation: an open-addressing table keyed by (space_id,
+ * page_no), each page with the list of its records in chunks from an
+ * arena */
+#define PAGE_INDEX_INIT_SIZE (1 << 16)
+#define PAGE_CHUNK_RECORDS 14
+typedef struct page_chunk_t {
+    struct page_chunk_t* next;      /* older records */
+    uint64_t lsn[PAGE_CHUNK_RECORDS];
+    byte type[PAGE_CHUNK_RECORDS];
+    uint16_t n;
+} page_chunk_t;
+
+/* a record kept for the apply plan, with its payload copied after it */
+typedef struct recv_t {
+    struct recv_t* next;    /* the next LSN on the page */
+    s_mtr_t mtr;            /* the views point into the copy */
+} recv_t;
+
+typedef struct page_stat_t {
+    uint32_t space_id;
+    uint32_t page_no;
+    uint64_t records;       /* 0: free slot */
+    uint64_t bytes;         /* of the record bodies */
+    uint64_t min_lsn;
+    uint64_t max_lsn;
+    page_chunk_t* chunks;   /* newest first */
+    recv_t* recs;           /* with keep_records, oldest first */
+    recv_t* last_rec;
+} page_stat_t;
 
-void read_block_into_buffer(buf_t *);
-byte* read_buffer_n(void*, buf_t*, const ssize_t);
+/* page_index_pages orders */
+enum page_order_t { PAGE_ORDER_RECORDS, PAGE_ORDER_ID };
+
+typedef struct page_index_t {
+    page_stat_t* slots;
+    size_t size;            /* a power of 2 */
+    size_t n;
+    arena_t arena;
+    int keep_records;       /* as recv_sys does, for the apply plan */
+} page_index_t;
+
+/* page apply engine over one tablespace file: page images are cached in
+ * frames hashed by page number and kept on an LRU list. When a miss finds
+ * the cache full with a dirty LRU page, all dirty pages are written out
+ * in page order, one pwritev per run of adjacent pages */
+#define APPLY_CACHE_PAGES 1024
+#define APPLY_WRITE_PAGES 64
+typedef struct page_frame_t {
+    struct page_frame_t* hash_next;
+    struct page_frame_t* prev;  /* LRU list, towards the most recent */
+    struct page_frame_t* next;  /* towards the least recent */
+    uint32_t page_no;
+    int dirty;
+    byte* page;             /* UNIV_PAGE_SIZE bytes */
+} page_frame_t;
+
+typedef struct apply_stat_t {
+    uint64_t applied;       /* records written into a page */
+    uint64_t skipped;       /* the page LSN is not older than the mtr */
+    uint64_t unsupported;   /* other page records of the space */
+    uint64_t bad;           /* writes past the end of the page */
+    uint64_t poisoned;      /* pages left alone, see poison_page */
+    uint64_t held;          /* records of those pages not applied */
+    uint64_t reads;         /* pages */
+    uint64_t writes;        /* pages */
+    uint64_t syscalls;
+    uint64_t flushes;       /* batches written */
+} apply_stat_t;
+
+typedef struct apply_t {
+    int fd;
+    uint32_t space_id;      /* from page 0 */
+    page_frame_t* frames;
+    byte* pages;
+    size_t n_frames;
+    size_t n_used;
+    page_frame_t** hash;
+    size_t hash_size;       /* a power of 2 */
+    page_frame_t lru;       /* list head: lru.next is the most recent */
+    uint32_t* poisoned;     /* page numbers + 1, open addressing, 0: free */
+    size_t poisoned_size;   /* a power of 2, 0 before the first */
+    uint32_t* mtr_pages;    /* written by the current mtr */
+    size_t mtr_pages_size;
+    apply_stat_t stats;
+} apply_t;
+
+/* see reader_init_opt for the defaults */
+typedef struct reader_opt_t {
+    int use_mmap;
+    ssize_t buffer_size;
+    int prefetch_depth;     /* 0: read synchronously */
+    int output_format;
+    int hexdump_full;
+    int log_level;          /* -1: no text output */
+    int from_checkpoint;    /* start at the newest valid checkpoint */
+    int stop_at_short_block;    /* the first block that is not full ends the log */
+    int stop_at_bad_block;  /* and a block with a bad checksum, being written */
+    uint64_t from_lsn;      /* skip the records before */
+    uint64_t to_lsn;        /* stop at the first record at or after, 0: none */
+    /* filters checked on the record header: the body of a record that
+     * does not pass is only walked to find its end, see record_passes */
+    int filter_space;       /* only the records of space_id */
+    uint32_t space_id;
+    int filter_page;        /* only the records of page_no */
+    uint32_t page_no;
+    int filter_type;        /* only the types set in types */
+    byte types[MLOG_BIGGEST_TYPE + 1];
+    int checksum;           /* checksum_t for verify_blocks */
+    int profile;            /* time the phases, see prof_t */
+    FILE* out;              /* text and record output, stdout if NULL */
+} reader_opt_t;
+
+/* one open log file (or log group) and the parse state over it; readers
+ * share nothing, so any number of them may run in different threads */
+typedef struct reader_t {
+    int fd;
+    byte* log_map;          /* mmap mode */
+    off_t log_size;         /* of each file */
+    log_hdr header;
+    /* group mode: file offsets are LSNs, see locate_block */
+    int group;
+    int n_files;
+    int* fds;               /* of each file, &fd for a single file */
+    byte** maps;
+    checkpoint_t checkpoint;
+    uint64_t start_lsn;     /* of the block at the first file offset read */
+    off_t file_offset;      /* next block to load */
+    off_t start_offset;     /* first record: after the header or the checkpoint */
+    off_t short_block;      /* with stop_at_short_block, -1: not seen yet */
+    off_t end_offset;       /* stop at the record starting here, 0: no limit */
+    off_t resume_offset;    /* of the record (or mtr) being read, where to
+                               go on when the log ended inside it */
+    buf_t buf;
+    prefetch_t* prefetch;
+    block_index_t* index;   /* built while reading when set */
+    reader_opt_t opt;
+    io_stat stats;
+    prof_t prof;
+    uint64_t records;
+    uint64_t type_records[MLOG_BIGGEST_TYPE + 1];
+    uint64_t resyncs;       /* unknown record types skipped */
+    uint64_t filtered;      /* records the filters dropped */
+    int by_mtr;             /* set by reader_next_mtr: the filters keep the
+                               MLOG_MULTI_REC_END records */
+    int log_indent;
+    out_buf_t rec_out;
+    out_buf_t payload_copy; /* see view_bytes */
+} reader_t;
+
+void reader_init_opt(reader_opt_t*);
+reader_t* reader_open(const char*, const reader_opt_t*);
+reader_t* reader_open_group(char* const*, int, const reader_opt_t*);
+void reader_seek(reader_t*, off_t);
+int reader_next_record(reader_t*, s_mtr_t*);
+int reader_next_mtr(reader_t*, mtr_group_t*);
+void free_mtr_group(mtr_group_t*);
+void reader_close(reader_t*);
+void reader_seek_index(reader_t*, const index_entry_t*);
+
+void hexdump(reader_t*, const byte*, ssize_t);
+void hexdump_view(reader_t*, const view_t*);
+
+void refill_buffer(reader_t*, const ssize_t);
+
+/* make n bytes available and return a pointer to them; with dst, decode
+ * an n byte big-endian integer into it and consume the bytes, or return
+ * NULL if the log ends before them. Without dst, fewer bytes may be left
+ * at the end of the log. n is a constant at every call site, so the switch
+ * is resolved when inlined */
+static inline byte* read_buffer_n(void* dst, reader_t* reader, const ssize_t n) {
+    buf_t* mtr_buf = &reader->buf;
+    assert(!dst || (dst && n <= 9));
+    if (mtr_buf->buffer_offset + n > mtr_buf->buffer_len)
+        refill_buffer(reader, n);
+    if (mtr_buf->buffer_len == 0) return NULL;
+
+    byte* val_ptr = mtr_buf->buffer + mtr_buf->buffer_offset;
+    if (dst) {
+        if (mtr_buf->buffer_offset + n > mtr_buf->buffer_len) return NULL;
+        switch (n) {
+            case 1: *(uint8_t*)dst = *val_ptr; break;
+            case 2: *(uint16_t*)dst = mach_read_2(val_ptr); break;
+            case 4: *(uint32_t*)dst = mach_read_4(val_ptr); break;
+            case 8: *(uint64_t*)dst = mach_read_8(val_ptr); break;
+            case 3: READ_N(*(uint32_t*)dst, val_ptr, n); break;
+            default: READ_N(*(uint64_t*)dst, val_ptr, n); break;
+        }
+        mtr_buf->buffer_offset += n;
+    }
+
+    /* return pointer to the value */
+    return val_ptr;
+}
+
+int init_buffer(buf_t*, ssize_t);
+void free_buffer(buf_t*);
+ssize_t parse_size(const char*);
+
+int stat_log_file(reader_t*, int);
+byte* map_log_file(reader_t*, int);
+void read_block_into_buffer(reader_t*);
+void map_block_into_buffer(reader_t*, const ssize_t);
+int append_block(reader_t*, const byte*);
+
+void start_prefetch(reader_t*);
+void stop_prefetch(reader_t*);
+void seek_prefetch(reader_t*, off_t);
+void submit_prefetch(reader_t*, int);
+byte* prefetch_block(reader_t*);
 /* mach_read_compressed */
-byte* read_compressed(uint32_t*, buf_t*);
-byte* read_compressed_64(uint64_t*, buf_t*);
+byte* read_compressed(uint32_t*, reader_t*);
+byte* read_compressed_64(uint64_t*, reader_t*);
+
+int skip_buffer_n(reader_t*, size_t);
+int read_view(view_t*, reader_t*, size_t);
+void resolve_view(view_t*, const view_t*);
+void payload_open(payload_cursor_t*, reader_t*, const view_t*);
+size_t payload_next(payload_cursor_t*, const byte**);
+int copy_view(reader_t*, const view_t*, byte*);
+const byte* view_bytes(reader_t*, const view_t*);
+
+off_t find_resync_block(reader_t*, off_t, block_hdr*);
+int find_block_header(reader_t*, off_t, block_hdr*);
+uint64_t block_no_to_lsn(const reader_t*, uint32_t);
+int locate_block(const reader_t*, off_t, off_t*, off_t*);
+off_t group_offset(const reader_t*, uint64_t);
+int block_in_sequence(const reader_t*, off_t, const block_hdr*);
+int block_in_log(reader_t*, off_t, const byte*, const block_hdr*);
+const byte* map_block(const reader_t*, off_t);
+const byte* read_log_block(reader_t*, off_t, byte*);
+
+uint32_t crc32c(const byte*, size_t);
+uint32_t log_block_checksum_innodb(const byte*);
+int log_block_checksum_is_ok(const reader_t*, const byte*);
+void verify_blocks(const reader_t*, int, off_t, off_t, verify_stat*);
 
-void parse_log_header();
+void index_block(reader_t*, off_t, const block_hdr*);
+const index_entry_t* find_index_entry(const block_index_t*, uint64_t);
+int write_index(const block_index_t*, const char*);
+int read_index(block_index_t*, const char*);
+void free_index(block_index_t*);
+
+int parse_log_header(reader_t*);
+int parse_checkpoint(reader_t*, off_t, checkpoint_t*);
+uint64_t fold_binary(const byte*, size_t);
+int read_checkpoint(reader_t*);
 void parse_block_header(const byte*, block_hdr*);
-byte* parse_index(const uint8_t, buf_t*);
-ssize_t parse_insert_rec(const uint8_t, buf_t*);
+int parse_index(const uint8_t, reader_t*, s_mtr_t*);
+int parse_insert_rec(reader_t*, mtr_insert_t*);
+size_t decode_insert_rec(const byte*, const byte*, mtr_insert_t*);
+int parse_trx_id(reader_t*, mtr_update_t*);
+int read_page_offset(reader_t*, s_mtr_t*);
 
 void clear_mtr(s_mtr_t *);
 uint8_t mtr_is_single_rec(const s_mtr_t*);
 const char* mtr_type_name(const s_mtr_t*);
+const char* log_type_name(byte);
+
+void out_reserve(out_buf_t*, size_t);
+void emit_record(reader_t*, const s_mtr_t*);
+void flush_records(reader_t*);
+
+void log_stat_add(log_stat_t*, const s_mtr_t*);
+void log_stat_merge(log_stat_t*, const log_stat_t*);
+
+void* arena_alloc(arena_t*, size_t);
+void arena_free(arena_t*);
+int page_index_init(page_index_t*);
+void page_index_free(page_index_t*);
+void page_index_add(page_index_t*, const s_mtr_t*);
+page_stat_t** page_index_pages(const page_index_t*, int);
+
+apply_t* apply_open(const char*, size_t);
+int apply_mtr(apply_t*, const mtr_group_t*);
+int apply_flush(apply_t*);
+void apply_close(apply_t*);
+
+void show_log_header(reader_t*, const log_hdr*);
+void show_checkpoint(reader_t*, const checkpoint_t*);
+void show_block_header(reader_t*, const block_hdr*);
+void show_mtr(reader_t*, const s_mtr_t*);
+void show_index(reader_t*, const s_mtr_t*);
+void show_insert_rec(reader_t*, const mtr_insert_t*);
+void show_trx_id(reader_t*, const mtr_update_t*);
+void show_io_stat(reader_t*);
+void show_prof_stat(const reader_t*, FILE*);
+void prof_estimate(const prof_t*, uint64_t, uint64_t*);
+void show_page_stat(reader_t*, const page_stat_t*);
+void show_page_recs(reader_t*, const page_stat_t*);
+void show_log_stat(reader_t*, const log_stat_t*);
+void show_mtr_group(reader_t*, const mtr_group_t*);
+void show_apply_stat(reader_t*, const apply_t*);
+
+void log_printf(reader_t*, const char*, ...);
+
+/* levels above RLR_MAX_LOG_LEVEL are compiled out, and the arguments of a
+ * disabled level are never evaluated */
+#ifndef RLR_MAX_LOG_LEVEL
+#define RLR_MAX_LOG_LEVEL 1
+#endif
+#define print_log(reader, level, ...) do { \
+    if ((level) <= RLR_MAX_LOG_LEVEL && (level) <= (reader)->opt.log_level) \
+        log_printf(reader, __VA_ARGS__); \
+} while (0)
+
+static inline uint64_t prof_ticks(void) {
+#if defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* the ticks of the sample running, without the refills in it */
+static inline void prof_end_sample(prof_t* prof, uint64_t now) {
+    uint64_t io = prof->ticks[PHASE_READ] + prof->ticks[PHASE_COMPACT];
+    prof->ticks[prof->sample_phase] += now - prof->sample_start - (io - prof->sample_io);
+    prof->sample_start = 0;
+}
+
+static inline void prof_start_sample(prof_t* prof, int phase, uint64_t now) {
+    prof->sample_phase = phase;
+    prof->sample_start = now;
+    prof->sample_io = prof->ticks[PHASE_READ] + prof->ticks[PHASE_COMPACT];
+}
+
+/* a record is asked for: end the output sample, maybe start a decode one */
+static inline void prof_enter(prof_t* prof) {
+    if (prof->sample_start) prof_end_sample(prof, prof_ticks());
+    if (++prof->calls % PROF_SAMPLE == 0)
+        prof_start_sample(prof, PHASE_DECODE, prof_ticks());
+}
+
+/* and returned: the decode sample goes on as an output one */
+static inline void prof_leave(prof_t* prof) {
+    uint64_t now;
+    if (!prof->sample_start) return;
+    now = prof_ticks();
+    prof_end_sample(prof, now);
+    prof_start_sample(prof, PHASE_OUTPUT, now);
+}
+
+#define PROF_ENTER(reader) do { \
+    if ((reader)->opt.profile) prof_enter(&(reader)->prof); \
+} while (0)
+#define PROF_LEAVE(reader) do { \
+    if ((reader)->opt.profile) prof_leave(&(reader)->prof); \
+} while (0)
+/* add the ticks since t to a refill phase, and move t to now */
+#define PROF_NOW(reader) ((reader)->opt.profile ? prof_ticks() : 0)
+#define PROF_ADD(reader, phase, t) do { \
+    if ((reader)->opt.profile) { \
+        uint64_t now_ = prof_ticks(); \
+        (reader)->prof.ticks[phase] += now_ - (t); \
+        (t) = now_; \
+    } \
+} while (0)
 
-void show_usages(void);
-void show_log_header(const log_hdr*);
-void show_block_header(const block_hdr*);
-void show_mtr(const s_mtr_t*);
-
-static int fd;
-static off_t file_offset;
-
-static int log_level = 0;
-static int log_indent = 0;
-void print_log(const int, const char*, ...);
-
-#define B2F(mtr_buf) \
-    (mtr_buf->start_file_offset \
-     + (mtr_buf->buffer_offset - mtr_buf->start_buffer_offset) \
-     / LOG_BLOCK_DATA_SIZE * OS_FILE_LOG_BLOCK_SIZE \
-     + LOG_BLOCK_HDR_SIZE \
-     + (mtr_buf->buffer_offset - mtr_buf->start_buffer_offset) \
-     % LOG_BLOCK_DATA_SIZE \
-    )
+/* file offset of the buffer position; positions before start_buffer_offset
+ * (the tail kept by a refill) map back into the preceding blocks */
+off_t buf_file_offset(const buf_t*, const off_t);
+uint64_t buf_lsn(const buf_t*, const off_t);
+off_t log_data_len(const off_t, const off_t);
+uint64_t lsn_add_data(uint64_t, uint64_t);
+#define B2F(mtr_buf) buf_file_offset(mtr_buf, (mtr_buf)->buffer_offset)
 
 #endif